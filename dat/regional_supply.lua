@@ -7,5 +7,9 @@ regional_supply.remove_from_demand = function(resourceID, demandRemoved) end  --
 regional_supply.add_to_supply = function(resourceID, supplyAdded) end  -- Adds to the existing supply of the specified resource.
 regional_supply.remove_from_supply = function(resourceID, supplyRemoved) end  -- Subtracts from the existing supply of the specified resource.
 regional_supply.get_resource_quantity = function(resourceID) return 0 end  -- Gets the current quantity of the specified resource.
+regional_supply.get_generation = function(resourceID) return 0 end  -- Gets a number that changes when any resource changes, or when the specified resource changes if resourceID is provided.
+regional_supply.get_resource_quantities = function(resourceIDs) return {} end  -- Gets the current quantities of an array of resources, the result uses the same indices.
+regional_supply.apply_deltas = function(deltas) end  -- Applies an array of { resourceID, amount } pairs, a positive amount adds supply and a negative amount adds demand.
+regional_supply.watch = function(resourceID, low, high, callbackName) end  -- Calls the named global function with (resourceID, quantity) once per tick after the quantity crosses the low or high threshold.
 
 -- EOF
\ No newline at end of file
@@ -0,0 +1,298 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "BuildingResourceCache.h"
+#include "cIGZVariant.h"
+#include "cISCProperty.h"
+#include "cISCPropertyHolder.h"
+#include "Logger.h"
+#include "Profiler.h"
+#include "PropertyUtil.h"
+#include "ResourceDeltaUtil.h"
+#include "ResourceEntryView.h"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <utility>
+
+static constexpr uint32_t RegionalSupplyConsumed = 0x16F4C223;
+static constexpr uint32_t RegionalSupplyProduced = 0x16F4C224;
+
+static constexpr std::array<uint32_t, 2> ResourcePropertyIDs =
+{
+	RegionalSupplyConsumed,
+	RegionalSupplyProduced
+};
+
+namespace
+{
+	enum class PropertyStatus
+	{
+		Missing,
+		Valid,
+		Invalid
+	};
+
+	uint64_t MakeInvalidPropertyKey(uint32_t buildingType, uint32_t propertyID)
+	{
+		return (static_cast<uint64_t>(buildingType) << 32) | propertyID;
+	}
+
+	PropertyStatus GetResourceEntries(const cISCPropertyHolder* pPropertyHolder, uint32_t id, ResourceEntryView& entries)
+	{
+		PROFILE_SCOPE(GetResourceEntries);
+
+		PropertyStatus result = PropertyStatus::Missing;
+
+		entries = ResourceEntryView();
+
+		const cISCProperty* pProperty = pPropertyHolder->GetProperty(id);
+
+		if (pProperty)
+		{
+			const cIGZVariant* pVariant = pProperty->GetPropertyValue();
+
+			if (pVariant)
+			{
+				const uint16_t type = pVariant->GetType();
+
+				if (type == cIGZVariant::Uint32Array)
+				{
+					const uint32_t count = pVariant->GetCount();
+
+					if (count > 0)
+					{
+						if ((count % 2) == 0)
+						{
+							entries = ResourceEntryView(pVariant->RefUint32(), count / 2);
+							result = PropertyStatus::Valid;
+						}
+						else
+						{
+							result = PropertyStatus::Invalid;
+						}
+					}
+				}
+			}
+		}
+
+		return result;
+	}
+}
+
+BuildingResourceCache::BuildingResourceCache()
+	: entries(),
+	  deltaPool()
+{
+}
+
+std::span<const ResourceDelta> BuildingResourceCache::GetInsertedDeltas(
+	uint32_t buildingType,
+	const cISCPropertyHolder* pPropertyHolder)
+{
+	const CacheEntry& entry = GetOrAddEntry(buildingType, pPropertyHolder);
+
+	if (entry.hasInvalidProperty)
+	{
+		CountInvalidPropertyOccupant(buildingType);
+	}
+
+	return std::span<const ResourceDelta>(deltaPool.data() + entry.poolOffset, entry.count);
+}
+
+std::span<const ResourceDelta> BuildingResourceCache::GetRemovedDeltas(
+	uint32_t buildingType,
+	const cISCPropertyHolder* pPropertyHolder)
+{
+	const CacheEntry& entry = GetOrAddEntry(buildingType, pPropertyHolder);
+
+	return std::span<const ResourceDelta>(deltaPool.data() + entry.poolOffset + entry.count, entry.count);
+}
+
+std::span<const ResourceDelta> BuildingResourceCache::GetCachedInsertedDeltas(uint32_t buildingType) const
+{
+	std::span<const ResourceDelta> deltas;
+
+	auto it = entries.find(buildingType);
+
+	if (it != entries.end())
+	{
+		deltas = std::span<const ResourceDelta>(deltaPool.data() + it->second.poolOffset, it->second.count);
+	}
+
+	return deltas;
+}
+
+const BuildingResourceCache::CacheEntry& BuildingResourceCache::GetOrAddEntry(
+	uint32_t buildingType,
+	const cISCPropertyHolder* pPropertyHolder)
+{
+	auto it = entries.find(buildingType);
+
+	if (it != entries.end())
+	{
+		return it->second;
+	}
+
+	CacheEntry entry{};
+	entry.poolOffset = static_cast<uint32_t>(deltaPool.size());
+
+	ResourceEntryView consumed;
+	ResourceEntryView produced;
+
+	if (GetResourceEntries(pPropertyHolder, RegionalSupplyConsumed, consumed) == PropertyStatus::Invalid)
+	{
+		AddInvalidProperty(buildingType, RegionalSupplyConsumed, pPropertyHolder);
+		entry.hasInvalidProperty = true;
+	}
+
+	if (GetResourceEntries(pPropertyHolder, RegionalSupplyProduced, produced) == PropertyStatus::Invalid)
+	{
+		AddInvalidProperty(buildingType, RegionalSupplyProduced, pPropertyHolder);
+		entry.hasInvalidProperty = true;
+	}
+
+	for (const ResourceEntry& resourceEntry : consumed)
+	{
+		deltaPool.emplace_back(resourceEntry.id, -static_cast<int64_t>(resourceEntry.amount));
+	}
+
+	for (const ResourceEntry& resourceEntry : produced)
+	{
+		deltaPool.emplace_back(resourceEntry.id, static_cast<int64_t>(resourceEntry.amount));
+	}
+
+	const size_t parsedCount = deltaPool.size() - entry.poolOffset;
+
+	if (parsedCount > 0)
+	{
+		// The deltas are stored pre-merged so that the manager can apply them without sorting.
+		entry.count = static_cast<uint32_t>(ResourceDeltaUtil::SortAndMerge(
+			deltaPool.data() + entry.poolOffset,
+			parsedCount));
+		deltaPool.resize(entry.poolOffset + entry.count);
+
+		for (uint32_t i = 0; i < entry.count; i++)
+		{
+			const ResourceDelta inserted = deltaPool[entry.poolOffset + i];
+
+			deltaPool.emplace_back(inserted.resourceID, -inserted.amount);
+		}
+	}
+
+	return entries.emplace(buildingType, entry).first->second;
+}
+
+void BuildingResourceCache::WriteInvalidPropertySummary()
+{
+	std::vector<std::pair<uint64_t, uint32_t>> occupantCounts;
+
+	for (auto& item : invalidPropertyOccupantCounts)
+	{
+		if (item.second > 0)
+		{
+			occupantCounts.emplace_back(item.first, item.second);
+			item.second = 0;
+		}
+	}
+
+	if (occupantCounts.empty() || !LOG_IS_ENABLED(LogLevel::Error))
+	{
+		return;
+	}
+
+	// Sorting the keys groups the properties of each building type together.
+	std::sort(occupantCounts.begin(), occupantCounts.end());
+
+	size_t i = 0;
+
+	while (i < occupantCounts.size())
+	{
+		const uint32_t buildingType = static_cast<uint32_t>(occupantCounts[i].first >> 32);
+		const uint32_t occupantCount = occupantCounts[i].second;
+
+		char propertyIDs[64]{};
+		size_t propertyIDsLength = 0;
+
+		for (; i < occupantCounts.size() && static_cast<uint32_t>(occupantCounts[i].first >> 32) == buildingType; i++)
+		{
+			const int length = std::snprintf(
+				propertyIDs + propertyIDsLength,
+				sizeof(propertyIDs) - propertyIDsLength,
+				propertyIDsLength > 0 ? ", 0x%08X" : "0x%08X",
+				static_cast<uint32_t>(occupantCounts[i].first));
+
+			if (length > 0)
+			{
+				propertyIDsLength = std::min(propertyIDsLength + static_cast<size_t>(length), sizeof(propertyIDs) - 1);
+			}
+		}
+
+		LOG_ERROR(
+			"Building 0x%08X was used by %u occupant(s) with an invalid resource property: %s.",
+			buildingType,
+			occupantCount,
+			propertyIDs);
+	}
+}
+
+void BuildingResourceCache::AddInvalidProperty(
+	uint32_t buildingType,
+	uint32_t propertyID,
+	const cISCPropertyHolder* pPropertyHolder)
+{
+	// The building type is only parsed once, so this is the only time that
+	// the display name is looked up for the error message.
+	if (invalidPropertyOccupantCounts.try_emplace(MakeInvalidPropertyKey(buildingType, propertyID), 0).second
+		&& LOG_IS_ENABLED(LogLevel::Error))
+	{
+		std::string_view displayName;
+
+		if (PropertyUtil::GetCachedDisplayName(buildingType, pPropertyHolder, displayName))
+		{
+			LOG_ERROR(
+				"%s (0x%08X) has an invalid 0x%08X property, the values must be id/amount pair(s).",
+				displayName.data(),
+				buildingType,
+				propertyID);
+		}
+		else
+		{
+			LOG_ERROR(
+				"Building 0x%08X has an invalid 0x%08X property, the values must be id/amount pair(s).",
+				buildingType,
+				propertyID);
+		}
+	}
+}
+
+void BuildingResourceCache::CountInvalidPropertyOccupant(uint32_t buildingType)
+{
+	for (uint32_t propertyID : ResourcePropertyIDs)
+	{
+		auto it = invalidPropertyOccupantCounts.find(MakeInvalidPropertyKey(buildingType, propertyID));
+
+		if (it != invalidPropertyOccupantCounts.end())
+		{
+			it->second++;
+		}
+	}
+}
@@ -0,0 +1,85 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include "IRegionalSupplyManager.h"
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+class cISCPropertyHolder;
+
+// Caches the regional supply deltas of each building type.
+//
+// The Regional Supply Consumed/Produced properties are parsed the first time a
+// building type is seen, and the merged deltas are stored in a contiguous pool.
+// Building types that do not have either property are also cached, so a repeat
+// occupant only costs a single lookup.
+//
+// A building type with an invalid property is logged the first time it is parsed,
+// after that the cache only counts its occupants. The counts are written to the
+// log by WriteInvalidPropertySummary.
+class BuildingResourceCache
+{
+public:
+	BuildingResourceCache();
+
+	// Gets the deltas that are applied when a building of the specified type is added to the city.
+	std::span<const ResourceDelta> GetInsertedDeltas(
+		uint32_t buildingType,
+		const cISCPropertyHolder* pPropertyHolder);
+
+	// Gets the deltas that are applied when a building of the specified type is removed from the city.
+	std::span<const ResourceDelta> GetRemovedDeltas(
+		uint32_t buildingType,
+		const cISCPropertyHolder* pPropertyHolder);
+
+	// Gets the inserted deltas of a building type that is already in the cache.
+	// Returns an empty span if the building type has not been cached.
+	std::span<const ResourceDelta> GetCachedInsertedDeltas(uint32_t buildingType) const;
+
+	// Writes one line for each building type that had occupants with an invalid property
+	// since the last call, and resets the occupant counts.
+	void WriteInvalidPropertySummary();
+
+private:
+	struct CacheEntry
+	{
+		// The inserted deltas start at poolOffset, and the removed deltas
+		// immediately follow them.
+		uint32_t poolOffset;
+		uint32_t count;
+		bool hasInvalidProperty;
+	};
+
+	const CacheEntry& GetOrAddEntry(uint32_t buildingType, const cISCPropertyHolder* pPropertyHolder);
+	void AddInvalidProperty(
+		uint32_t buildingType,
+		uint32_t propertyID,
+		const cISCPropertyHolder* pPropertyHolder);
+	void CountInvalidPropertyOccupant(uint32_t buildingType);
+
+	std::unordered_map<uint32_t, CacheEntry> entries;
+	std::vector<ResourceDelta> deltaPool;
+	// The key is the building type in the upper 32 bits and the property id in
+	// the lower 32 bits, the value is the number of occupants since the last summary.
+	std::unordered_map<uint64_t, uint32_t> invalidPropertyOccupantCounts;
+};
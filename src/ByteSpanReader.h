@@ -0,0 +1,77 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+// Reads little-endian serial record fields from a byte span.
+// The methods mirror the cIGZPersistDBSerialRecord field methods so that the
+// record parsers can be shared with the COM path.
+class ByteSpanReader
+{
+public:
+	explicit ByteSpanReader(std::span<const uint8_t> data)
+		: data(data), position(0)
+	{
+	}
+
+	bool GetFieldUint32(uint32_t& value)
+	{
+		return GetFieldVoid(&value, sizeof(value));
+	}
+
+	bool GetFieldSint64(int64_t& value)
+	{
+		return GetFieldVoid(&value, sizeof(value));
+	}
+
+	bool GetFieldVoid(void* buffer, uint32_t size)
+	{
+		std::span<const uint8_t> field;
+
+		if (!GetFieldSpan(size, field))
+		{
+			return false;
+		}
+
+		std::memcpy(buffer, field.data(), field.size());
+		return true;
+	}
+
+	// Returns a view of the next size bytes without copying them.
+	bool GetFieldSpan(uint32_t size, std::span<const uint8_t>& field)
+	{
+		if (size > (data.size() - position))
+		{
+			return false;
+		}
+
+		field = data.subspan(position, size);
+		position += size;
+		return true;
+	}
+
+private:
+	std::span<const uint8_t> data;
+	size_t position;
+};
@@ -0,0 +1,102 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Crc32C.h"
+#include <array>
+
+namespace
+{
+	constexpr uint32_t Polynomial = 0x82F63B78; // Reversed CRC-32C polynomial.
+
+	// The checksum is computed 8 bytes at a time using the slicing-by-8 algorithm.
+	constexpr std::array<std::array<uint32_t, 256>, 8> BuildTables()
+	{
+		std::array<std::array<uint32_t, 256>, 8> tables{};
+
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t crc = i;
+
+			for (int bit = 0; bit < 8; bit++)
+			{
+				crc = (crc >> 1) ^ ((crc & 1) ? Polynomial : 0);
+			}
+
+			tables[0][i] = crc;
+		}
+
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			for (size_t table = 1; table < 8; table++)
+			{
+				const uint32_t previous = tables[table - 1][i];
+
+				tables[table][i] = (previous >> 8) ^ tables[0][previous & 0xFF];
+			}
+		}
+
+		return tables;
+	}
+
+	constexpr auto Tables = BuildTables();
+
+	uint32_t ReadUint32LE(const uint8_t* p)
+	{
+		return static_cast<uint32_t>(p[0])
+			| (static_cast<uint32_t>(p[1]) << 8)
+			| (static_cast<uint32_t>(p[2]) << 16)
+			| (static_cast<uint32_t>(p[3]) << 24);
+	}
+}
+
+uint32_t Crc32C::Compute(const void* data, size_t size, uint32_t crc)
+{
+	const uint8_t* p = static_cast<const uint8_t*>(data);
+
+	crc = ~crc;
+
+	while (size >= 8)
+	{
+		const uint32_t low = ReadUint32LE(p) ^ crc;
+		const uint32_t high = ReadUint32LE(p + 4);
+
+		crc = Tables[7][low & 0xFF]
+			^ Tables[6][(low >> 8) & 0xFF]
+			^ Tables[5][(low >> 16) & 0xFF]
+			^ Tables[4][low >> 24]
+			^ Tables[3][high & 0xFF]
+			^ Tables[2][(high >> 8) & 0xFF]
+			^ Tables[1][(high >> 16) & 0xFF]
+			^ Tables[0][high >> 24];
+
+		p += 8;
+		size -= 8;
+	}
+
+	while (size > 0)
+	{
+		crc = (crc >> 8) ^ Tables[0][(crc ^ *p) & 0xFF];
+		p++;
+		size--;
+	}
+
+	return ~crc;
+}
@@ -0,0 +1,169 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DBPFIndexReader.h"
+
+namespace
+{
+	constexpr uint32_t DBPFSignature = 0x46504244; // DBPF
+	constexpr size_t HeaderSize = 96;
+
+	constexpr uint32_t DirectoryType = 0xE86B1EEF;
+	constexpr uint32_t DirectoryGroup = 0xE86B1EEF;
+	constexpr uint32_t DirectoryInstance = 0x286B1F03;
+
+	uint32_t ReadUint32LE(std::span<const uint8_t> data, size_t offset)
+	{
+		const uint8_t* p = data.data() + offset;
+
+		return static_cast<uint32_t>(p[0])
+			| (static_cast<uint32_t>(p[1]) << 8)
+			| (static_cast<uint32_t>(p[2]) << 16)
+			| (static_cast<uint32_t>(p[3]) << 24);
+	}
+
+	bool TryGetSubspan(std::span<const uint8_t> data, uint32_t offset, uint32_t size, std::span<const uint8_t>& result)
+	{
+		if (offset > data.size() || size > (data.size() - offset))
+		{
+			return false;
+		}
+
+		result = data.subspan(offset, size);
+		return true;
+	}
+
+	bool EntryMatches(std::span<const uint8_t> entry, uint32_t type, uint32_t group, uint32_t instance)
+	{
+		return ReadUint32LE(entry, 0) == type
+			&& ReadUint32LE(entry, 4) == group
+			&& ReadUint32LE(entry, 8) == instance;
+	}
+}
+
+DBPFIndexReader::DBPFIndexReader()
+	: fileData(),
+	  indexData(),
+	  indexEntrySize(0),
+	  directoryData(),
+	  directoryEntrySize(0)
+{
+}
+
+bool DBPFIndexReader::Open(std::span<const uint8_t> data)
+{
+	fileData = std::span<const uint8_t>();
+	indexData = std::span<const uint8_t>();
+	directoryData = std::span<const uint8_t>();
+
+	if (data.size() < HeaderSize
+		|| ReadUint32LE(data, 0) != DBPFSignature
+		|| ReadUint32LE(data, 4) != 1) // Major version
+	{
+		return false;
+	}
+
+	const uint32_t indexMajorVersion = ReadUint32LE(data, 0x20);
+	const uint32_t indexEntryCount = ReadUint32LE(data, 0x24);
+	const uint32_t indexOffset = ReadUint32LE(data, 0x28);
+	const uint32_t indexSize = ReadUint32LE(data, 0x2C);
+	const uint32_t indexMinorVersion = ReadUint32LE(data, 0x3C);
+
+	if (indexMajorVersion != 7)
+	{
+		return false;
+	}
+
+	// Index version 7.1 adds a second instance id to each entry.
+	indexEntrySize = indexMinorVersion >= 2 ? 24 : 20;
+	directoryEntrySize = indexMinorVersion >= 2 ? 20 : 16;
+
+	if (!TryGetSubspan(data, indexOffset, indexSize, indexData)
+		|| (static_cast<uint64_t>(indexEntryCount) * indexEntrySize) > indexSize)
+	{
+		return false;
+	}
+
+	indexData = indexData.first(indexEntryCount * indexEntrySize);
+
+	// Every record must be within the file, this allows FindRecord to treat
+	// a missing entry as the only failure case.
+	for (size_t offset = 0; offset < indexData.size(); offset += indexEntrySize)
+	{
+		const size_t locationOffset = offset + indexEntrySize - 8;
+
+		std::span<const uint8_t> recordData;
+
+		if (!TryGetSubspan(data, ReadUint32LE(indexData, locationOffset), ReadUint32LE(indexData, locationOffset + 4), recordData))
+		{
+			return false;
+		}
+	}
+
+	fileData = data;
+
+	std::span<const uint8_t> directory;
+
+	if (FindRecord(DirectoryType, DirectoryGroup, DirectoryInstance, directory))
+	{
+		directoryData = directory.first(directory.size() - (directory.size() % directoryEntrySize));
+	}
+
+	return true;
+}
+
+bool DBPFIndexReader::FindRecord(
+	uint32_t type,
+	uint32_t group,
+	uint32_t instance,
+	std::span<const uint8_t>& recordData) const
+{
+	for (size_t offset = 0; offset < indexData.size(); offset += indexEntrySize)
+	{
+		const std::span<const uint8_t> entry = indexData.subspan(offset, indexEntrySize);
+
+		if (EntryMatches(entry, type, group, instance))
+		{
+			const size_t locationOffset = indexEntrySize - 8;
+
+			return TryGetSubspan(
+				fileData,
+				ReadUint32LE(entry, locationOffset),
+				ReadUint32LE(entry, locationOffset + 4),
+				recordData);
+		}
+	}
+
+	return false;
+}
+
+bool DBPFIndexReader::IsCompressed(uint32_t type, uint32_t group, uint32_t instance) const
+{
+	for (size_t offset = 0; offset < directoryData.size(); offset += directoryEntrySize)
+	{
+		if (EntryMatches(directoryData.subspan(offset, directoryEntrySize), type, group, instance))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
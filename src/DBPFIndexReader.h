@@ -0,0 +1,49 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <cstdint>
+#include <span>
+
+// Locates records in the index of a DBPF 1.x file that is already in memory.
+// The record data is returned as a view into the file data, nothing is copied.
+class DBPFIndexReader
+{
+public:
+	DBPFIndexReader();
+
+	// Parses the header and the index.
+	// Returns false if the data is not a supported DBPF file.
+	bool Open(std::span<const uint8_t> fileData);
+
+	// Returns false if the file does not contain the record.
+	bool FindRecord(uint32_t type, uint32_t group, uint32_t instance, std::span<const uint8_t>& recordData) const;
+
+	// Returns true if the record is listed in the file's compression directory.
+	bool IsCompressed(uint32_t type, uint32_t group, uint32_t instance) const;
+
+private:
+	std::span<const uint8_t> fileData;
+	std::span<const uint8_t> indexData;
+	size_t indexEntrySize;
+	std::span<const uint8_t> directoryData;
+	size_t directoryEntrySize;
+};
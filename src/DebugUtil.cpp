@@ -21,52 +21,57 @@
 
 #include "DebugUtil.h"
 #include "cIGZString.h"
-#include "cIGZVariant.h"
-#include "cISCProperty.h"
-#include "cISCPropertyHolder.h"
 #include "cISC4Occupant.h"
-#include "cRZAutoRefCount.h"
-#include "StringResourceKey.h"
-#include "StringResourceManager.h"
+#include "PropertyUtil.h"
 #include <memory>
 #include <vector>
 #include <Windows.h>
 
+#ifdef _DEBUG
+#include <crtdbg.h>
+#endif // _DEBUG
+
 namespace
 {
-	bool GetOccupantNameKey(cISC4Occupant* pOccupant, StringResourceKey& key)
+#ifdef _DEBUG
+	thread_local uint64_t threadAllocationCount = 0;
+	_CRT_ALLOC_HOOK previousAllocHook = nullptr;
+
+	int __cdecl CountingAllocHook(
+		int allocType,
+		void* userData,
+		size_t size,
+		int blockType,
+		long requestNumber,
+		const unsigned char* filename,
+		int lineNumber)
 	{
-		bool result = false;
-
-		if (pOccupant)
+		if (allocType == _HOOK_ALLOC || allocType == _HOOK_REALLOC)
 		{
-			cISCPropertyHolder* propertyHolder = pOccupant->AsPropertyHolder();
-
-			constexpr uint32_t kUserVisibleName = 0x8A416A99;
-
-			cISCProperty* userVisibleName = propertyHolder->GetProperty(kUserVisibleName);
-
-			if (userVisibleName)
-			{
-				const cIGZVariant* propertyValue = userVisibleName->GetPropertyValue();
-
-				if (propertyValue->GetType() == cIGZVariant::Type::Uint32Array
-					&& propertyValue->GetCount() == 3)
-				{
-					const uint32_t* pTGI = propertyValue->RefUint32();
+			threadAllocationCount++;
+		}
 
-					uint32_t group = pTGI[1];
-					uint32_t instance = pTGI[2];
+		return previousAllocHook ? previousAllocHook(
+			allocType,
+			userData,
+			size,
+			blockType,
+			requestNumber,
+			filename,
+			lineNumber) : TRUE;
+	}
 
-					key.groupID = group;
-					key.instanceID = instance;
-					result = true;
-				}
-			}
-		}
+	uint64_t GetThreadAllocationCount()
+	{
+		[[maybe_unused]] static const bool hookInstalled = []()
+		{
+			previousAllocHook = _CrtSetAllocHook(CountingAllocHook);
+			return true;
+		}();
 
-		return result;
+		return threadAllocationCount;
 	}
+#endif // _DEBUG
 }
 
 
@@ -155,15 +160,34 @@ void DebugUtil::PrintLineToDebugOutputFormatted(const char* const format, ...)
 
 void DebugUtil::PrintOccupantNameToDebugOutput(cISC4Occupant* pOccupant)
 {
-	StringResourceKey occupantNameKey;
-
-	if (GetOccupantNameKey(pOccupant, occupantNameKey))
+	if (pOccupant)
 	{
-		cRZAutoRefCount<cIGZString> name;
+		std::string_view name;
 
-		if (StringResourceManager::GetLocalizedString(occupantNameKey, name.AsPPObj()))
+		if (PropertyUtil::GetCachedUserVisibleName(pOccupant->AsPropertyHolder(), name))
 		{
-			PrintLineToDebugOutput(name->ToChar());
+			PrintLineToDebugOutput(name.data());
 		}
 	}
 }
+
+#ifdef _DEBUG
+DebugUtil::ScopedAllocationCheck::ScopedAllocationCheck(const char* const scopeName)
+	: scopeName(scopeName),
+	  startCount(GetThreadAllocationCount())
+{
+}
+
+DebugUtil::ScopedAllocationCheck::~ScopedAllocationCheck()
+{
+	const uint64_t allocationCount = GetThreadAllocationCount() - startCount;
+
+	if (allocationCount > 0)
+	{
+		PrintLineToDebugOutputFormatted(
+			"%s made %llu heap allocation(s).",
+			scopeName,
+			allocationCount);
+	}
+}
+#endif // _DEBUG
@@ -20,6 +20,7 @@
  */
 
 #pragma once
+#include <cstdint>
 
 class cIGZString;
 class cISC4Occupant;
@@ -32,4 +33,23 @@ namespace DebugUtil
 	void PrintLineToDebugOutputFormatted(const char* const format, ...);
 
 	void PrintOccupantNameToDebugOutput(cISC4Occupant* pOccupant);
+
+#ifdef _DEBUG
+	// Counts the debug CRT heap allocations that the current thread makes while
+	// the object is in scope, and prints the total to the debug output if it
+	// is not zero.
+	class ScopedAllocationCheck
+	{
+	public:
+		explicit ScopedAllocationCheck(const char* const scopeName);
+		~ScopedAllocationCheck();
+
+		ScopedAllocationCheck(const ScopedAllocationCheck&) = delete;
+		ScopedAllocationCheck& operator=(const ScopedAllocationCheck&) = delete;
+
+	private:
+		const char* const scopeName;
+		const uint64_t startCount;
+	};
+#endif // _DEBUG
 }
\ No newline at end of file
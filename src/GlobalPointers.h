@@ -21,5 +21,7 @@
 
 #pragma once
 #include "IRegionalSupplyManager.h"
+#include "ResourceWatchList.h"
 
-extern IRegionalSupplyManager* spRegionalSupplyManager;
\ No newline at end of file
+extern IRegionalSupplyManager2* spRegionalSupplyManager;
+extern ResourceWatchList* spResourceWatchList;
\ No newline at end of file
@@ -20,9 +20,36 @@
  */
 
 #pragma once
+#include "cIGZUnknown.h"
+#include <cstddef>
 #include <cstdint>
+#include <span>
 
-class IRegionalSupplyManager
+struct ResourceDelta
+{
+	uint32_t resourceID;
+	// Positive values add to the resource supply, negative values add to the resource demand.
+	int64_t amount;
+};
+
+// The id of the GZCOM system service that implements IRegionalSupplyManager.
+// Native plugins can get the interface from cIGZFrameWork::GetSystemService.
+static constexpr uint32_t kRegionalSupplyManagerServiceID = 0x5BB3E4D1;
+
+// The interface ids are versioned, a published interface is never changed.
+// New methods are added in a new interface that derives from the previous
+// version and has its own interface id.
+static constexpr uint32_t GZIID_IRegionalSupplyManager = 0x0F8D5A3B;
+static constexpr uint32_t GZIID_IRegionalSupplyManager2 = 0x7C41B09E;
+
+// The regional resource pool.
+// The methods are thread-safe and can be called from any thread, but they can block:
+// - Every method waits for the region data to finish loading after the game switches
+//   to a different region.
+// - The methods that change the quantities wait while a save snapshot is being taken,
+//   and wait for the journal writer if its queue is full.
+// Reading a quantity or generation does not take a lock once the region data is loaded.
+class IRegionalSupplyManager : public cIGZUnknown
 {
 public:
 	virtual void AddToDemand(uint32_t resourceID, uint32_t amount) = 0;
@@ -31,4 +58,28 @@ public:
 	virtual void RemoveFromSupply(uint32_t resourceID, uint32_t amount) = 0;
 
 	virtual int64_t GetResourceQuantity(uint32_t resourceID) const = 0;
+
+	// Applies a set of resource changes in a single call.
+	// Deltas that use the same resource id are merged before they are applied.
+	virtual void ApplyDeltas(const ResourceDelta* pDeltas, size_t count) = 0;
+
+	void ApplyDeltas(std::span<const ResourceDelta> deltas)
+	{
+		ApplyDeltas(deltas.data(), deltas.size());
+	}
+};
+
+// Version 2 adds the change generations.
+// A caller can cache a value that is derived from the resource quantities,
+// and only recompute it when the generation differs from the cached one.
+class IRegionalSupplyManager2 : public IRegionalSupplyManager
+{
+public:
+	// Gets a counter that increases whenever any resource quantity changes
+	// or a different region is loaded.
+	virtual uint64_t GetGeneration() const = 0;
+
+	// Gets a value that changes whenever the quantity of the specified
+	// resource changes or a different region is loaded.
+	virtual uint64_t GetResourceGeneration(uint32_t resourceID) const = 0;
 };
\ No newline at end of file
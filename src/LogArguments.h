@@ -0,0 +1,165 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+
+// Captures printf-style arguments into a byte buffer so that the line can be
+// formatted later on another thread.
+//
+// Arithmetic, enum and pointer values are copied as-is. C strings are copied
+// into the buffer, so the caller's string can be released before the line
+// is formatted.
+namespace LogArguments
+{
+	template <typename T>
+	constexpr bool IsString = std::is_same_v<T, const char*> || std::is_same_v<T, char*>;
+
+	// The type that is passed to snprintf when the line is formatted.
+	template <typename T>
+	using StoredType = std::conditional_t<IsString<T>, const char*, T>;
+
+	class Writer
+	{
+	public:
+		Writer(char* buffer, size_t capacity)
+			: buffer(buffer),
+			  capacity(capacity),
+			  offset(0),
+			  overflowed(false)
+		{
+		}
+
+		bool Overflowed() const
+		{
+			return overflowed;
+		}
+
+		template <typename T> void Write(const T& value)
+		{
+			if constexpr (IsString<T>)
+			{
+				WriteString(value);
+			}
+			else
+			{
+				static_assert(
+					std::is_arithmetic_v<T> || std::is_enum_v<T> || std::is_pointer_v<T>,
+					"Log arguments must be numbers, pointers or C strings.");
+
+				WriteBytes(&value, sizeof(T), alignof(T));
+			}
+		}
+
+	private:
+		void WriteString(const char* value)
+		{
+			const char* const text = value ? value : "(null)";
+			const size_t length = std::strlen(text);
+
+			WriteBytes(&length, sizeof(length), alignof(size_t));
+			WriteBytes(text, length + 1, 1);
+		}
+
+		void WriteBytes(const void* data, size_t size, size_t alignment)
+		{
+			const size_t alignedOffset = (offset + alignment - 1) & ~(alignment - 1);
+
+			if (overflowed || alignedOffset > capacity || size > (capacity - alignedOffset))
+			{
+				overflowed = true;
+				return;
+			}
+
+			std::memcpy(buffer + alignedOffset, data, size);
+			offset = alignedOffset + size;
+		}
+
+		char* const buffer;
+		const size_t capacity;
+		size_t offset;
+		bool overflowed;
+	};
+
+	class Reader
+	{
+	public:
+		explicit Reader(const char* buffer)
+			: buffer(buffer),
+			  offset(0)
+		{
+		}
+
+		template <typename T> StoredType<T> Read()
+		{
+			if constexpr (IsString<T>)
+			{
+				size_t length = 0;
+				ReadBytes(&length, sizeof(length), alignof(size_t));
+
+				const char* text = buffer + offset;
+				offset += length + 1;
+
+				return text;
+			}
+			else
+			{
+				T value{};
+				ReadBytes(&value, sizeof(T), alignof(T));
+
+				return value;
+			}
+		}
+
+	private:
+		void ReadBytes(void* data, size_t size, size_t alignment)
+		{
+			offset = (offset + alignment - 1) & ~(alignment - 1);
+
+			std::memcpy(data, buffer + offset, size);
+			offset += size;
+		}
+
+		const char* const buffer;
+		size_t offset;
+	};
+
+	using FormatFunction = int (*)(char* destination, size_t destinationSize, const char* format, const char* arguments);
+
+	// Formats the arguments that a Writer captured, the types must match the Write calls.
+	template <typename... TArgs>
+	int Format(char* destination, size_t destinationSize, const char* format, const char* arguments)
+	{
+		Reader reader(arguments);
+
+		// The elements of a braced initializer list are evaluated in order.
+		const std::tuple<StoredType<TArgs>...> values{ reader.Read<TArgs>()... };
+
+		return std::apply(
+			[&](const auto&... args) { return std::snprintf(destination, destinationSize, format, args...); },
+			values);
+	}
+}
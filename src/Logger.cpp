@@ -20,15 +20,27 @@
  */
 
 #include "Logger.h"
+#include <cstdio>
+
+#ifdef _WIN32
 #include <Windows.h>
+#endif // _WIN32
 
 namespace
 {
+	constexpr size_t RecordIndexMask = Logger::RecordCount - 1;
+
+	static_assert((Logger::RecordCount & RecordIndexMask) == 0, "RecordCount must be a power of 2.");
+
 #ifdef _DEBUG
 	void PrintLineToDebugOutput(const char* line)
 	{
+#ifdef _WIN32
 		OutputDebugStringA(line);
 		OutputDebugStringA("\n");
+#else
+		std::fprintf(stderr, "%s\n", line);
+#endif // _WIN32
 	}
 #endif // _DEBUG
 }
@@ -40,23 +52,55 @@ Logger& Logger::GetInstance()
 	return logger;
 }
 
-Logger::Logger() : initialized(false), logFile(), logLevel(LogLevel::Error)
+Logger::Logger()
+	: initialized(false),
+	  logLevel(LogLevel::Error),
+	  logFile(),
+	  records(std::make_unique<Record[]>(RecordCount)),
+	  enqueuePosition(0),
+	  dequeuePosition(0),
+	  droppedLineCount(0),
+	  wakeCounter(0),
+	  stopRequested(false),
+	  writerThread()
 {
+	for (size_t i = 0; i < RecordCount; i++)
+	{
+		records[i].sequence.store(i, std::memory_order_relaxed);
+	}
 }
 
 Logger::~Logger()
 {
-	initialized = false;
+	// The director calls Shutdown when the application exits, this is a fallback.
+	Shutdown();
 }
 
 void Logger::Init(std::filesystem::path logFilePath, LogLevel options)
 {
 	if (!initialized)
 	{
-		initialized = true;
-
 		logFile.open(logFilePath, std::ofstream::out | std::ofstream::trunc);
 		logLevel = options;
+
+		if (logFile)
+		{
+			writerThread = std::thread(&Logger::WriterThreadProc, this);
+			initialized.store(true, std::memory_order_release);
+		}
+	}
+}
+
+void Logger::Shutdown()
+{
+	if (writerThread.joinable())
+	{
+		initialized.store(false, std::memory_order_release);
+		stopRequested.store(true, std::memory_order_release);
+		wakeCounter.fetch_add(1, std::memory_order_release);
+		wakeCounter.notify_one();
+
+		writerThread.join();
 	}
 }
 
@@ -67,20 +111,12 @@ bool Logger::IsEnabled(LogLevel level) const
 
 void Logger::WriteLogFileHeader(const char* const text)
 {
-	if (initialized && logFile)
-	{
-		logFile << text << std::endl;
-	}
+	WriteLineFormatted(logLevel, "%s", text);
 }
 
 void Logger::WriteLine(LogLevel level, const char* const message)
 {
-	if (!IsEnabled(level))
-	{
-		return;
-	}
-
-	WriteLineCore(message);
+	WriteLineFormatted(level, "%s", message);
 }
 
 void Logger::WriteLineFormatted(LogLevel level, const char* const format, ...)
@@ -93,35 +129,146 @@ void Logger::WriteLineFormatted(LogLevel level, const char* const format, ...)
 	va_list args;
 	va_start(args, format);
 
-	va_list argsCopy;
-	va_copy(argsCopy, args);
+	WriteLineCore(format, args);
 
-	int formattedStringLength = std::vsnprintf(nullptr, 0, format, argsCopy);
+	va_end(args);
+}
 
-	va_end(argsCopy);
+void Logger::WriteLineCore(const char* const format, va_list args)
+{
+	size_t position = 0;
+	Record* record = TryClaimRecord(position);
 
-	if (formattedStringLength > 0)
+	if (record)
 	{
-		size_t formattedStringLengthWithNull = static_cast<size_t>(formattedStringLength) + 1;
+		// The line is formatted directly into the record, vsnprintf truncates
+		// lines that are longer than the record.
+		record->formatFunction = nullptr;
 
-		std::unique_ptr<char[]> buffer = std::make_unique_for_overwrite<char[]>(formattedStringLengthWithNull);
+		if (std::vsnprintf(record->data, sizeof(record->data), format, args) < 0)
+		{
+			record->data[0] = '\0';
+		}
 
-		std::vsnprintf(buffer.get(), formattedStringLengthWithNull, format, args);
+		PublishRecord(record, position);
+	}
+}
 
-		WriteLineCore(buffer.get());
+Logger::Record* Logger::TryClaimRecord(size_t& position)
+{
+	if (!initialized.load(std::memory_order_acquire))
+	{
+		return nullptr;
 	}
 
-	va_end(args);
+	// A bounded multi-producer queue, each record has a sequence number that
+	// tells the producers which lap of the ring buffer it is free for.
+	position = enqueuePosition.load(std::memory_order_relaxed);
+
+	while (true)
+	{
+		Record& record = records[position & RecordIndexMask];
+
+		const size_t sequence = record.sequence.load(std::memory_order_acquire);
+		const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+		if (difference == 0)
+		{
+			if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				return &record;
+			}
+		}
+		else if (difference < 0)
+		{
+			// The writer thread has not written the record from the previous lap.
+			droppedLineCount.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+		else
+		{
+			position = enqueuePosition.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+void Logger::PublishRecord(Record* record, size_t position)
+{
+	record->sequence.store(position + 1, std::memory_order_release);
+
+	wakeCounter.fetch_add(1, std::memory_order_release);
+	wakeCounter.notify_one();
 }
 
-void Logger::WriteLineCore(const char* const message)
+void Logger::WriterThreadProc()
 {
-	if (initialized && logFile)
+	while (true)
 	{
+		const uint32_t observedWakeCounter = wakeCounter.load(std::memory_order_acquire);
+
+		if (WriteQueuedLines())
+		{
+			logFile.flush();
+		}
+
+		if (stopRequested.load(std::memory_order_acquire))
+		{
+			// Write any lines that were queued before the stop request.
+			WriteQueuedLines();
+			break;
+		}
+
+		wakeCounter.wait(observedWakeCounter, std::memory_order_acquire);
+	}
+
+	logFile.close();
+}
+
+bool Logger::WriteQueuedLines()
+{
+	bool wroteLines = false;
+	char formattedLine[MaxLineLength];
+
+	while (true)
+	{
+		Record& record = records[dequeuePosition & RecordIndexMask];
+
+		if (record.sequence.load(std::memory_order_acquire) != (dequeuePosition + 1))
+		{
+			break;
+		}
+
+		const char* text = record.data;
+
+		if (record.formatFunction)
+		{
+			if (record.formatFunction(formattedLine, sizeof(formattedLine), record.format, record.data) < 0)
+			{
+				formattedLine[0] = '\0';
+			}
+
+			text = formattedLine;
+		}
+
 #ifdef _DEBUG
-		PrintLineToDebugOutput(message);
+		PrintLineToDebugOutput(text);
 #endif // _DEBUG
 
-		logFile << message << '\n';
+		logFile << text << '\n';
+
+		// Make the record available to the producers on the next lap.
+		record.sequence.store(dequeuePosition + RecordCount, std::memory_order_release);
+		dequeuePosition++;
+		wroteLines = true;
 	}
-}
\ No newline at end of file
+
+	const uint32_t droppedLines = droppedLineCount.exchange(0, std::memory_order_relaxed);
+
+	if (droppedLines > 0)
+	{
+		logFile << droppedLines << " log line(s) were dropped because the log queue was full." << '\n';
+		wroteLines = true;
+	}
+
+	return wroteLines;
+}
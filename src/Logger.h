@@ -20,8 +20,13 @@
  */
 
 #pragma once
+#include "LogArguments.h"
+#include <atomic>
+#include <cstdarg>
 #include <filesystem>
 #include <fstream>
+#include <memory>
+#include <thread>
 
 enum class LogLevel : int32_t
 {
@@ -31,6 +36,64 @@ enum class LogLevel : int32_t
 	Trace = 3
 };
 
+// The most verbose level that the LOG_* macros are compiled for, the calls
+// for the levels above it are removed at compile time.
+#ifndef REGIONAL_SUPPLY_MAX_LOG_LEVEL
+#ifdef _DEBUG
+#define REGIONAL_SUPPLY_MAX_LOG_LEVEL 3 // LogLevel::Trace
+#else
+#define REGIONAL_SUPPLY_MAX_LOG_LEVEL 1 // LogLevel::Error
+#endif
+#endif // REGIONAL_SUPPLY_MAX_LOG_LEVEL
+
+// Lets the compiler check printf-style format strings against their arguments.
+// GCC and Clang use the format attribute, MSVC checks the annotated parameter
+// when the code analysis (/analyze) is enabled.
+#if defined(__GNUC__) || defined(__clang__)
+#define LOG_PRINTF_FORMAT_ATTRIBUTE(formatIndex, firstArgumentIndex) \
+	__attribute__((format(printf, formatIndex, firstArgumentIndex)))
+#else
+#define LOG_PRINTF_FORMAT_ATTRIBUTE(formatIndex, firstArgumentIndex)
+#endif
+
+#ifdef _MSC_VER
+#include <sal.h>
+#define LOG_PRINTF_FORMAT_STRING _Printf_format_string_
+#else
+#define LOG_PRINTF_FORMAT_STRING
+#endif
+
+// The format string of a deferred log line.
+// The constructor is consteval, so the format must be a constant expression,
+// e.g. a string literal. A constant has static storage duration, which lets the
+// writer thread use the pointer after the caller has returned. A char array that
+// is built at runtime does not compile.
+class LogFormat
+{
+public:
+	template <size_t N>
+	consteval LogFormat(const char (&format)[N])
+		: pFormat(format)
+	{
+		if (format[N - 1] != '\0')
+		{
+			throw "The log format must be null-terminated.";
+		}
+	}
+
+	const char* Get() const
+	{
+		return pFormat;
+	}
+
+private:
+	const char* pFormat;
+};
+
+// The log lines are formatted into a fixed-size ring buffer that a background
+// thread writes to the log file, so the calling thread never waits for the file.
+// Any thread can write to the log. If the ring buffer is full the line is dropped,
+// the number of dropped lines is written to the log when space is available.
 class Logger
 {
 public:
@@ -38,6 +101,8 @@ public:
 	static Logger& GetInstance();
 
 	void Init(std::filesystem::path logFilePath, LogLevel logLevel);
+	// Writes the queued lines to the log file and stops the background thread.
+	void Shutdown();
 
 	bool IsEnabled(LogLevel option) const;
 
@@ -45,17 +110,124 @@ public:
 
 	void WriteLine(LogLevel level, const char* const message);
 
-	void WriteLineFormatted(LogLevel level, const char* const format, ...);
+	// The argument 1 is the implicit this pointer.
+	void WriteLineFormatted(LogLevel level, LOG_PRINTF_FORMAT_STRING const char* const format, ...)
+		LOG_PRINTF_FORMAT_ATTRIBUTE(3, 4);
+
+	// Copies the arguments into the queue, the line is formatted by the background
+	// thread. Use the LOG_* macros instead of calling this method directly.
+	template <typename... TArgs>
+	void WriteLineDeferred(LogLevel level, LogFormat format, const TArgs&... args)
+	{
+		if (!IsEnabled(level))
+		{
+			return;
+		}
+
+		size_t position = 0;
+		Record* record = TryClaimRecord(position);
+
+		if (record)
+		{
+			LogArguments::Writer writer(record->data, sizeof(record->data));
+			(writer.Write<std::decay_t<const TArgs>>(args), ...);
+
+			if (writer.Overflowed())
+			{
+				// The arguments do not fit in the record, format the line now.
+				record->formatFunction = nullptr;
+
+				if (std::snprintf(record->data, sizeof(record->data), format.Get(), args...) < 0)
+				{
+					record->data[0] = '\0';
+				}
+			}
+			else
+			{
+				record->formatFunction = &LogArguments::Format<std::decay_t<const TArgs>...>;
+				record->format = format.Get();
+			}
+
+			PublishRecord(record, position);
+		}
+	}
+
+	// The maximum line length, including the terminating null.
+	// Longer lines are truncated.
+	static constexpr size_t MaxLineLength = 512;
+	static constexpr size_t RecordCount = 256;
 
 private:
 
+	struct Record
+	{
+		// Used by the producers and the writer thread to find out if the
+		// record is free or holds a line that has not been written yet.
+		std::atomic<size_t> sequence;
+		// Formats the captured arguments in data, if this is nullptr data
+		// contains the formatted line.
+		LogArguments::FormatFunction formatFunction;
+		const char* format;
+		alignas(std::max_align_t) char data[MaxLineLength];
+	};
+
 	Logger();
 	~Logger();
 
-	void WriteLineCore(const char* const message);
+	void WriteLineCore(const char* const format, va_list args);
+	// Returns nullptr if the logger is not initialized or the ring buffer is full.
+	Record* TryClaimRecord(size_t& position);
+	void PublishRecord(Record* record, size_t position);
 
-	bool initialized;
+	void WriterThreadProc();
+	bool WriteQueuedLines();
+
+	std::atomic<bool> initialized;
 	LogLevel logLevel;
 	std::ofstream logFile;
+	std::unique_ptr<Record[]> records;
+	std::atomic<size_t> enqueuePosition;
+	// Only accessed by the writer thread.
+	size_t dequeuePosition;
+	std::atomic<uint32_t> droppedLineCount;
+	// Incremented when a line is queued, the writer thread waits for it to change.
+	std::atomic<uint32_t> wakeCounter;
+	std::atomic<bool> stopRequested;
+	std::thread writerThread;
 };
 
+// Never called, the LOG_* macros pass their arguments to it in a discarded
+// branch so that the compiler checks the format string.
+LOG_PRINTF_FORMAT_ATTRIBUTE(1, 2) inline void LogCheckFormat(LOG_PRINTF_FORMAT_STRING const char*, ...)
+{
+}
+
+// The log lines of the plugin are written with these macros, the format
+// string and its arguments are checked at compile time.
+#define LOG_AT_LEVEL(level, ...) \
+	do \
+	{ \
+		if (false) \
+		{ \
+			LogCheckFormat(__VA_ARGS__); \
+		} \
+		if constexpr (static_cast<int32_t>(level) <= REGIONAL_SUPPLY_MAX_LOG_LEVEL) \
+		{ \
+			Logger& logMacroLogger = Logger::GetInstance(); \
+			if (logMacroLogger.IsEnabled(level)) \
+			{ \
+				logMacroLogger.WriteLineDeferred(level, __VA_ARGS__); \
+			} \
+		} \
+	} while (0)
+
+// Can be used to skip building the arguments of a log line, the check
+// is removed at compile time for the levels above the build-time limit.
+#define LOG_IS_ENABLED(level) \
+	((static_cast<int32_t>(level) <= REGIONAL_SUPPLY_MAX_LOG_LEVEL) && Logger::GetInstance().IsEnabled(level))
+
+// The arguments are only evaluated if the level is enabled.
+#define LOG_INFO(...) LOG_AT_LEVEL(LogLevel::Info, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT_LEVEL(LogLevel::Error, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT_LEVEL(LogLevel::Debug, __VA_ARGS__)
+#define LOG_TRACE(...) LOG_AT_LEVEL(LogLevel::Trace, __VA_ARGS__)
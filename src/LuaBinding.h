@@ -0,0 +1,154 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include "cISCLua.h"
+#include "SCLuaUtil.h"
+#include <cstdint>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// Generates the Lua C function thunks for native member functions.
+//
+// The thunk checks the argument count, reads and validates each argument
+// according to the parameter type and then calls the member function.
+// Everything is resolved at compile time, a call does not allocate.
+// If an argument is invalid the function is not called, and a function that
+// returns a value returns 0 to Lua.
+namespace LuaBinding
+{
+	inline bool TryGetNumber(cISCLua* pLua, int32_t index, uint32_t& value)
+	{
+		value = 0;
+
+		if (pLua->Type(index) != cIGZLua5Thread::LuaTypeNumber)
+		{
+			return false;
+		}
+
+		const double number = pLua->ToNumber(index);
+
+		// NaN fails both comparisons.
+		if (!(number >= static_cast<double>(std::numeric_limits<uint32_t>::min())
+			  && number <= static_cast<double>(std::numeric_limits<uint32_t>::max())))
+		{
+			return false;
+		}
+
+		value = static_cast<uint32_t>(number);
+		return true;
+	}
+
+	inline bool TryGetNumber(cISCLua* pLua, int32_t index, int64_t& value)
+	{
+		value = 0;
+
+		if (pLua->Type(index) != cIGZLua5Thread::LuaTypeNumber)
+		{
+			return false;
+		}
+
+		const double number = pLua->ToNumber(index);
+
+		// The upper limit is exclusive because INT64_MAX cannot be represented as a double.
+		// NaN fails both comparisons.
+		if (!(number >= -9223372036854775808.0 && number < 9223372036854775808.0))
+		{
+			return false;
+		}
+
+		value = static_cast<int64_t>(number);
+		return true;
+	}
+
+	template <typename T> void PushResult(cISCLua* pLua, T value)
+	{
+		static_assert(std::is_arithmetic_v<T>, "The return type must be a number.");
+
+		pLua->PushNumber(static_cast<double>(value));
+	}
+
+	template <typename TMethod> struct MethodTraits;
+
+	template <typename TClass, typename TResult, typename... TArgs>
+	struct MethodTraits<TResult(TClass::*)(TArgs...)>
+	{
+		using Result = TResult;
+		using Arguments = std::tuple<std::remove_cvref_t<TArgs>...>;
+	};
+
+	template <typename TClass, typename TResult, typename... TArgs>
+	struct MethodTraits<TResult(TClass::*)(TArgs...) const>
+	{
+		using Result = TResult;
+		using Arguments = std::tuple<std::remove_cvref_t<TArgs>...>;
+	};
+
+	template <typename TArguments, size_t... Indices>
+	bool TryGetArguments(cISCLua* pLua, TArguments& arguments, std::index_sequence<Indices...>)
+	{
+		// The first argument is at stack index 1.
+		return (TryGetNumber(pLua, static_cast<int32_t>(Indices + 1), std::get<Indices>(arguments)) && ...);
+	}
+
+	// A Lua C function that calls Method on the object that ppInstance points to.
+	// ppInstance is the address of a global pointer, so that the thunk uses the
+	// object that the pointer refers to when the function is called.
+	template <auto ppInstance, auto Method> int32_t MethodThunk(lua_State* pState)
+	{
+		using Traits = MethodTraits<decltype(Method)>;
+		using Result = typename Traits::Result;
+		using Arguments = typename Traits::Arguments;
+
+		constexpr size_t ArgumentCount = std::tuple_size_v<Arguments>;
+
+		cRZAutoRefCount<cISCLua> lua = SCLuaUtil::GetISCLuaFromFunctionState(pState);
+
+		Arguments arguments{};
+
+		const bool argumentsValid = lua->GetTop() == static_cast<int32_t>(ArgumentCount)
+			&& TryGetArguments(lua, arguments, std::make_index_sequence<ArgumentCount>());
+
+		const auto call = [&]()
+		{
+			return std::apply(
+				[&](auto... args) { return ((*ppInstance)->*Method)(args...); },
+				arguments);
+		};
+
+		if constexpr (std::is_void_v<Result>)
+		{
+			if (argumentsValid)
+			{
+				call();
+			}
+
+			return 0;
+		}
+		else
+		{
+			PushResult(lua, argumentsValid ? call() : Result{});
+			return 1;
+		}
+	}
+}
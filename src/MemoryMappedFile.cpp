@@ -0,0 +1,138 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MemoryMappedFile.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#include "wil/resource.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+MemoryMappedFile::MemoryMappedFile()
+	: pView(nullptr),
+	  size(0)
+{
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+	Close();
+}
+
+bool MemoryMappedFile::Open(const std::filesystem::path& path)
+{
+	Close();
+
+#ifdef _WIN32
+	wil::unique_hfile file(CreateFileW(
+		path.c_str(),
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+		nullptr));
+
+	if (!file)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize{};
+
+	// An empty file cannot be mapped.
+	if (!GetFileSizeEx(file.get(), &fileSize) || fileSize.QuadPart <= 0 || fileSize.QuadPart > SIZE_MAX)
+	{
+		return false;
+	}
+
+	wil::unique_handle mapping(CreateFileMappingW(file.get(), nullptr, PAGE_READONLY, 0, 0, nullptr));
+
+	if (!mapping)
+	{
+		return false;
+	}
+
+	// The view keeps the file mapping alive after the handles are closed.
+	pView = static_cast<const uint8_t*>(MapViewOfFile(mapping.get(), FILE_MAP_READ, 0, 0, 0));
+
+	if (!pView)
+	{
+		return false;
+	}
+
+	size = static_cast<size_t>(fileSize.QuadPart);
+#else
+	const int fd = open(path.c_str(), O_RDONLY);
+
+	if (fd == -1)
+	{
+		return false;
+	}
+
+	struct stat fileInfo {};
+
+	if (fstat(fd, &fileInfo) == 0 && fileInfo.st_size > 0)
+	{
+		void* view = mmap(nullptr, static_cast<size_t>(fileInfo.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (view != MAP_FAILED)
+		{
+			pView = static_cast<const uint8_t*>(view);
+			size = static_cast<size_t>(fileInfo.st_size);
+		}
+	}
+
+	close(fd);
+
+	if (!pView)
+	{
+		return false;
+	}
+#endif // _WIN32
+
+	return true;
+}
+
+void MemoryMappedFile::Close()
+{
+	if (pView)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(pView);
+#else
+		munmap(const_cast<uint8_t*>(pView), size);
+#endif // _WIN32
+
+		pView = nullptr;
+		size = 0;
+	}
+}
+
+std::span<const uint8_t> MemoryMappedFile::GetData() const
+{
+	return std::span<const uint8_t>(pView, size);
+}
@@ -0,0 +1,182 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Profiler.h"
+
+#if REGIONAL_SUPPLY_PROFILING
+#include "Logger.h"
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+
+namespace
+{
+	// Values below LinearBucketCount have their own bucket, larger values are split
+	// into 8 buckets per power of two. The bucket width is at most 12.5% of its value.
+	constexpr uint32_t SubBucketBits = 3;
+	constexpr uint32_t SubBucketCount = 1U << SubBucketBits;
+	constexpr uint32_t LinearBucketCount = SubBucketCount;
+	constexpr uint32_t BucketCount = (64 - SubBucketBits + 1) * SubBucketCount;
+
+	constexpr const char* ScopeNames[] =
+	{
+		"Message: InsertOccupant",
+		"Message: RemoveOccupant",
+		"Message: PreCityInit",
+		"Message: PostCityInit",
+		"Message: PostCityShutdown",
+		"Message: PostRegionInit",
+		"Building property parsing",
+		"Manager: LoadRegion",
+		"Manager: SaveAsync snapshot",
+		"Manager: WriteSnapshot",
+		"Manager: ApplyDeltas",
+		"Manager: BeginCitySession",
+		"Lua: add_to_demand",
+		"Lua: remove_from_demand",
+		"Lua: add_to_supply",
+		"Lua: remove_from_supply",
+		"Lua: get_resource_quantity",
+		"Lua: get_generation",
+		"Lua: get_resource_quantities",
+		"Lua: apply_deltas",
+		"Lua: watch",
+		"Lua: watch callbacks",
+	};
+
+	static_assert(std::size(ScopeNames) == static_cast<size_t>(Profiler::Scope::Count));
+
+	struct Histogram
+	{
+		std::array<std::atomic<uint64_t>, BucketCount> buckets;
+		std::atomic<uint64_t> count;
+		std::atomic<uint64_t> maxCycles;
+	};
+
+	std::array<Histogram, static_cast<size_t>(Profiler::Scope::Count)> histograms;
+
+	// The reference points that are used to convert cycles to microseconds.
+	const uint64_t calibrationStartCycles = Profiler::ReadCycleCounter();
+	const std::chrono::steady_clock::time_point calibrationStartTime = std::chrono::steady_clock::now();
+
+	uint32_t GetBucketIndex(uint64_t cycles)
+	{
+		if (cycles < LinearBucketCount)
+		{
+			return static_cast<uint32_t>(cycles);
+		}
+
+		const uint32_t exponent = 63 - static_cast<uint32_t>(std::countl_zero(cycles));
+		const uint32_t subBucket = static_cast<uint32_t>(cycles >> (exponent - SubBucketBits)) & (SubBucketCount - 1);
+
+		return ((exponent - SubBucketBits + 1) * SubBucketCount) + subBucket;
+	}
+
+	uint64_t GetBucketUpperBound(uint32_t index)
+	{
+		if (index < LinearBucketCount)
+		{
+			return index;
+		}
+
+		const uint32_t exponent = (index / SubBucketCount) + SubBucketBits - 1;
+		const uint64_t subBucket = index % SubBucketCount;
+
+		return ((SubBucketCount + subBucket + 1) << (exponent - SubBucketBits)) - 1;
+	}
+
+	uint64_t GetPercentile(const Histogram& histogram, uint64_t count, uint32_t percentile)
+	{
+		// The rank of the sample at the percentile, rounded up.
+		const uint64_t rank = ((count * percentile) + 99) / 100;
+		uint64_t total = 0;
+
+		for (uint32_t i = 0; i < BucketCount; i++)
+		{
+			total += histogram.buckets[i].load(std::memory_order_relaxed);
+
+			if (total >= rank)
+			{
+				return std::min(GetBucketUpperBound(i), histogram.maxCycles.load(std::memory_order_relaxed));
+			}
+		}
+
+		return histogram.maxCycles.load(std::memory_order_relaxed);
+	}
+
+	double GetCyclesPerMicrosecond()
+	{
+		const uint64_t elapsedCycles = Profiler::ReadCycleCounter() - calibrationStartCycles;
+		const std::chrono::duration<double, std::micro> elapsedTime = std::chrono::steady_clock::now() - calibrationStartTime;
+
+		return elapsedTime.count() > 0.0 ? static_cast<double>(elapsedCycles) / elapsedTime.count() : 1.0;
+	}
+}
+
+void Profiler::Record(Scope scope, uint64_t cycles)
+{
+	Histogram& histogram = histograms[static_cast<size_t>(scope)];
+
+	histogram.buckets[GetBucketIndex(cycles)].fetch_add(1, std::memory_order_relaxed);
+	histogram.count.fetch_add(1, std::memory_order_relaxed);
+
+	uint64_t maxCycles = histogram.maxCycles.load(std::memory_order_relaxed);
+
+	while (cycles > maxCycles
+		&& !histogram.maxCycles.compare_exchange_weak(maxCycles, cycles, std::memory_order_relaxed))
+	{
+	}
+}
+
+void Profiler::WriteSummary()
+{
+	const double cyclesPerMicrosecond = GetCyclesPerMicrosecond();
+
+	LOG_INFO("Latency summary (count, p50, p99, max in microseconds):");
+
+	for (size_t i = 0; i < histograms.size(); i++)
+	{
+		Histogram& histogram = histograms[i];
+
+		const uint64_t count = histogram.count.load(std::memory_order_relaxed);
+
+		if (count > 0)
+		{
+			LOG_INFO(
+				"%s: %llu, %.2f, %.2f, %.2f",
+				ScopeNames[i],
+				static_cast<unsigned long long>(count),
+				static_cast<double>(GetPercentile(histogram, count, 50)) / cyclesPerMicrosecond,
+				static_cast<double>(GetPercentile(histogram, count, 99)) / cyclesPerMicrosecond,
+				static_cast<double>(histogram.maxCycles.load(std::memory_order_relaxed)) / cyclesPerMicrosecond);
+		}
+
+		for (std::atomic<uint64_t>& bucket : histogram.buckets)
+		{
+			bucket.store(0, std::memory_order_relaxed);
+		}
+
+		histogram.count.store(0, std::memory_order_relaxed);
+		histogram.maxCycles.store(0, std::memory_order_relaxed);
+	}
+}
+#endif // REGIONAL_SUPPLY_PROFILING
@@ -0,0 +1,116 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <cstdint>
+
+// Hot path latency instrumentation.
+//
+// Set REGIONAL_SUPPLY_PROFILING to 1 in the project preprocessor definitions to
+// record the time spent in the PROFILE_SCOPE blocks. The times are measured with
+// the CPU time stamp counter and recorded into fixed-size log-linear histograms,
+// a summary is written to the log when PROFILE_WRITE_SUMMARY is called.
+// When REGIONAL_SUPPLY_PROFILING is 0 the macros expand to nothing.
+#ifndef REGIONAL_SUPPLY_PROFILING
+#define REGIONAL_SUPPLY_PROFILING 0
+#endif
+
+#if REGIONAL_SUPPLY_PROFILING
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif // REGIONAL_SUPPLY_PROFILING
+
+namespace Profiler
+{
+	enum class Scope : uint32_t
+	{
+		MessageInsertOccupant = 0,
+		MessageRemoveOccupant,
+		MessagePreCityInit,
+		MessagePostCityInit,
+		MessagePostCityShutdown,
+		MessagePostRegionInit,
+		GetResourceEntries,
+		ManagerLoadRegion,
+		ManagerSaveSnapshot,
+		ManagerWriteSnapshot,
+		ManagerApplyDeltas,
+		ManagerBeginCitySession,
+		LuaAddToDemand,
+		LuaRemoveFromDemand,
+		LuaAddToSupply,
+		LuaRemoveFromSupply,
+		LuaGetResourceQuantity,
+		LuaGetGeneration,
+		LuaGetResourceQuantities,
+		LuaApplyDeltas,
+		LuaWatch,
+		LuaDispatchWatchEvents,
+		Count
+	};
+
+#if REGIONAL_SUPPLY_PROFILING
+	inline uint64_t ReadCycleCounter()
+	{
+		return __rdtsc();
+	}
+
+	// Records a sample, this method can be called from any thread.
+	void Record(Scope scope, uint64_t cycles);
+
+	// Writes the count, p50, p99 and maximum time of each scope to the log
+	// and clears the histograms.
+	void WriteSummary();
+
+	class ScopedTimer
+	{
+	public:
+		explicit ScopedTimer(Scope scope)
+			: scope(scope),
+			  startCycles(ReadCycleCounter())
+		{
+		}
+
+		~ScopedTimer()
+		{
+			Record(scope, ReadCycleCounter() - startCycles);
+		}
+
+		ScopedTimer(const ScopedTimer&) = delete;
+		ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+	private:
+		const Scope scope;
+		const uint64_t startCycles;
+	};
+#endif // REGIONAL_SUPPLY_PROFILING
+}
+
+#if REGIONAL_SUPPLY_PROFILING
+#define PROFILE_SCOPE(scope) const Profiler::ScopedTimer profileScopeTimer(Profiler::Scope::scope)
+#define PROFILE_WRITE_SUMMARY() Profiler::WriteSummary()
+#else
+#define PROFILE_SCOPE(scope)
+#define PROFILE_WRITE_SUMMARY()
+#endif // REGIONAL_SUPPLY_PROFILING
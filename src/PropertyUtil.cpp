@@ -22,9 +22,13 @@
 #include "PropertyUtil.h"
 #include "cIGZVariant.h"
 #include "cISCProperty.h"
+#include "cRZBaseString.h"
 #include "SCPropertyUtil.h"
 #include "StringResourceKey.h"
 #include "StringResourceManager.h"
+#include <mutex>
+#include <string>
+#include <unordered_map>
 
 namespace
 {
@@ -60,21 +64,121 @@ namespace
 		return result;
 	}
 
-	bool TryGetUserVisibleName(
-		const cISCPropertyHolder* pPropertyHolder,
-		cRZAutoRefCount<cIGZString>& name)
+	// The localized user visible names, the key is the string resource group id
+	// in the upper 32 bits and the instance id in the lower 32 bits.
+	// The cache keeps a reference to each localized string and the map entries are
+	// never removed, so the string data has a stable address.
+	class UserVisibleNameCache
 	{
-		bool result = false;
+	public:
+		bool TryGetName(const StringResourceKey& key, std::string_view& name)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			const cRZAutoRefCount<cIGZString>& localizedName = GetOrAddLocked(key);
 
-		StringResourceKey key;
+			if (localizedName)
+			{
+				name = std::string_view(localizedName->ToChar(), localizedName->Strlen());
+			}
+
+			return localizedName != nullptr;
+		}
 
-		if (GetUserVisibleNameKey(pPropertyHolder, key))
+		bool TryGetName(const StringResourceKey& key, cRZAutoRefCount<cIGZString>& name)
 		{
-			result = StringResourceManager::GetLocalizedString(key, name.AsPPObj());
+			std::lock_guard<std::mutex> lock(mutex);
+
+			const cRZAutoRefCount<cIGZString>& localizedName = GetOrAddLocked(key);
+
+			if (localizedName)
+			{
+				name = localizedName;
+			}
+
+			return localizedName != nullptr;
 		}
 
-		return result;
-	}
+	private:
+		const cRZAutoRefCount<cIGZString>& GetOrAddLocked(const StringResourceKey& key)
+		{
+			const uint64_t cacheKey = (static_cast<uint64_t>(key.groupID) << 32) | key.instanceID;
+
+			auto it = names.find(cacheKey);
+
+			if (it == names.end())
+			{
+				cRZAutoRefCount<cIGZString> localizedName;
+
+				// Keys without a localized string are also cached as a null string,
+				// so a missing string is only searched for once.
+				if (!StringResourceManager::GetLocalizedString(key, localizedName.AsPPObj()))
+				{
+					localizedName = cRZAutoRefCount<cIGZString>();
+				}
+
+				it = names.emplace(cacheKey, localizedName).first;
+			}
+
+			return it->second;
+		}
+
+		std::mutex mutex;
+		std::unordered_map<uint64_t, cRZAutoRefCount<cIGZString>> names;
+	};
+
+	UserVisibleNameCache userVisibleNameCache;
+
+	// The display names keyed by the exemplar id, see PropertyUtil::GetCachedDisplayName.
+	// The map entries are never removed, so the interned strings have a stable address.
+	class DisplayNameCache
+	{
+	public:
+		bool TryGetName(
+			uint32_t exemplarID,
+			const cISCPropertyHolder* pPropertyHolder,
+			std::string_view& name)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			auto it = names.find(exemplarID);
+
+			if (it == names.end())
+			{
+				Entry entry{};
+				cRZBaseString displayName;
+
+				// Exemplars without a display name are also cached, so their
+				// properties are only read once.
+				if (PropertyUtil::GetDisplayName(pPropertyHolder, displayName))
+				{
+					entry.found = true;
+					entry.name.assign(displayName.ToChar(), displayName.Strlen());
+				}
+
+				it = names.emplace(exemplarID, std::move(entry)).first;
+			}
+
+			if (it->second.found)
+			{
+				name = it->second.name;
+			}
+
+			return it->second.found;
+		}
+
+	private:
+		struct Entry
+		{
+			bool found;
+			std::string name;
+		};
+
+		std::mutex mutex;
+		std::unordered_map<uint32_t, Entry> names;
+	};
+
+	DisplayNameCache displayNameCache;
 
 	bool TryGetUserVisibleName(
 		const cISCPropertyHolder* pPropertyHolder,
@@ -82,11 +186,11 @@ namespace
 	{
 		bool result = false;
 
-		cRZAutoRefCount<cIGZString> userVisibleName;
+		std::string_view userVisibleName;
 
-		if (TryGetUserVisibleName(pPropertyHolder, userVisibleName))
+		if (PropertyUtil::GetCachedUserVisibleName(pPropertyHolder, userVisibleName))
 		{
-			name.Copy(*userVisibleName);
+			name.FromChar(userVisibleName.data(), static_cast<uint32_t>(userVisibleName.size()));
 			result = true;
 		}
 
@@ -129,5 +233,38 @@ bool PropertyUtil::GetUserVisibleName(
 	const cISCPropertyHolder* pPropertyHolder,
 	cRZAutoRefCount<cIGZString>& name)
 {
-	return TryGetUserVisibleName(pPropertyHolder, name);
+	bool result = false;
+
+	StringResourceKey key;
+
+	if (GetUserVisibleNameKey(pPropertyHolder, key))
+	{
+		result = userVisibleNameCache.TryGetName(key, name);
+	}
+
+	return result;
+}
+
+bool PropertyUtil::GetCachedUserVisibleName(
+	const cISCPropertyHolder* pPropertyHolder,
+	std::string_view& name)
+{
+	bool result = false;
+
+	StringResourceKey key;
+
+	if (GetUserVisibleNameKey(pPropertyHolder, key))
+	{
+		result = userVisibleNameCache.TryGetName(key, name);
+	}
+
+	return result;
+}
+
+bool PropertyUtil::GetCachedDisplayName(
+	uint32_t exemplarID,
+	const cISCPropertyHolder* pPropertyHolder,
+	std::string_view& name)
+{
+	return displayNameCache.TryGetName(exemplarID, pPropertyHolder, name);
 }
@@ -23,6 +23,7 @@
 #include "cIGZString.h"
 #include "cISCPropertyHolder.h"
 #include "cRZAutoRefCount.h"
+#include <string_view>
 
 namespace PropertyUtil
 {
@@ -37,4 +38,22 @@ namespace PropertyUtil
 	bool GetUserVisibleName(
 		const cISCPropertyHolder* pPropertyHolder,
 		cRZAutoRefCount<cIGZString>& name);
+
+	// Gets the user visible name of the exemplar from a cache that is keyed by the
+	// name's string resource group and instance ids.
+	// The localized string is loaded the first time a key is seen, the returned name
+	// is null-terminated and remains valid until the plugin is unloaded.
+	bool GetCachedUserVisibleName(
+		const cISCPropertyHolder* pPropertyHolder,
+		std::string_view& name);
+
+	// Gets the display name of the exemplar from a cache that is keyed by the exemplar id,
+	// the properties are only read the first time an id is seen.
+	// cISCPropertyHolder does not expose the exemplar's resource key, so the caller
+	// provides an id that identifies the exemplar, e.g. the building type.
+	// The returned name is null-terminated and remains valid until the plugin is unloaded.
+	bool GetCachedDisplayName(
+		uint32_t exemplarID,
+		const cISCPropertyHolder* pPropertyHolder,
+		std::string_view& name);
 };
@@ -0,0 +1,158 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RegionStateCache.h"
+#include "Logger.h"
+#include <algorithm>
+
+RegionStateCache::RegionStateCache(size_t memoryBudget)
+	: entries(),
+	  memoryUsage(0),
+	  memoryBudget(memoryBudget),
+	  hitCount(0),
+	  missCount(0)
+{
+}
+
+void RegionStateCache::Insert(
+	const std::filesystem::path& dataFilePath,
+	const std::filesystem::path& journalPath,
+	RegionState&& state)
+{
+	const std::filesystem::path regionDirectory = dataFilePath.parent_path();
+
+	auto existing = std::find_if(
+		entries.begin(),
+		entries.end(),
+		[&](const Entry& entry) { return entry.regionDirectory == regionDirectory; });
+
+	if (existing != entries.end())
+	{
+		memoryUsage -= existing->memoryUsage;
+		entries.erase(existing);
+	}
+
+	const size_t stateMemoryUsage = GetMemoryUsage(state);
+
+	if (stateMemoryUsage <= memoryBudget)
+	{
+		entries.emplace_front(
+			regionDirectory,
+			GetFileStamp(dataFilePath),
+			GetFileStamp(journalPath),
+			stateMemoryUsage,
+			std::move(state));
+		memoryUsage += stateMemoryUsage;
+
+		EvictToBudget();
+	}
+}
+
+bool RegionStateCache::TryTake(
+	const std::filesystem::path& dataFilePath,
+	const std::filesystem::path& journalPath,
+	RegionState& state)
+{
+	bool result = false;
+
+	const std::filesystem::path regionDirectory = dataFilePath.parent_path();
+
+	auto it = std::find_if(
+		entries.begin(),
+		entries.end(),
+		[&](const Entry& entry) { return entry.regionDirectory == regionDirectory; });
+
+	if (it != entries.end())
+	{
+		// The files can be changed by another copy of the plugin or a backup tool.
+		if (it->dataFileStamp == GetFileStamp(dataFilePath)
+			&& it->journalStamp == GetFileStamp(journalPath))
+		{
+			state = std::move(it->state);
+			result = true;
+		}
+
+		memoryUsage -= it->memoryUsage;
+		entries.erase(it);
+	}
+
+	if (result)
+	{
+		hitCount++;
+	}
+	else
+	{
+		missCount++;
+	}
+
+	LOG_DEBUG(
+		"Region state cache %s (hits: %llu, misses: %llu, memory: %zu bytes).",
+		result ? "hit" : "miss",
+		static_cast<unsigned long long>(hitCount),
+		static_cast<unsigned long long>(missCount),
+		memoryUsage);
+
+	return result;
+}
+
+RegionStateCache::FileStamp RegionStateCache::GetFileStamp(const std::filesystem::path& path)
+{
+	FileStamp stamp{};
+
+	std::error_code ec;
+	const uintmax_t size = std::filesystem::file_size(path, ec);
+
+	if (!ec)
+	{
+		const std::filesystem::file_time_type lastWriteTime = std::filesystem::last_write_time(path, ec);
+
+		if (!ec)
+		{
+			stamp.exists = true;
+			stamp.size = size;
+			stamp.lastWriteTime = lastWriteTime;
+		}
+	}
+
+	return stamp;
+}
+
+size_t RegionStateCache::GetMemoryUsage(const RegionState& state)
+{
+	size_t usage = sizeof(Entry) + state.resources.GetMemoryUsage();
+
+	for (const auto& item : state.cityLedgers)
+	{
+		// Approximates the map node overhead with the size of the node's value.
+		usage += sizeof(item) + item.first.capacity() + item.second->GetMemoryUsage();
+	}
+
+	return usage;
+}
+
+void RegionStateCache::EvictToBudget()
+{
+	while (memoryUsage > memoryBudget && !entries.empty())
+	{
+		memoryUsage -= entries.back().memoryUsage;
+		entries.pop_back();
+	}
+}
@@ -0,0 +1,98 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include "ResourceTable.h"
+#include <filesystem>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+
+// The resource data of a region that is not currently loaded.
+struct RegionState
+{
+	using CityLedgerMap = std::map<std::string, std::shared_ptr<ResourceTable>, std::less<>>;
+
+	ResourceTable resources;
+	CityLedgerMap cityLedgers;
+	uint32_t snapshotSequence = 0;
+	// The checksum of the last saved snapshot.
+	uint32_t persistedChecksum = 0;
+	// The number of records in the journal when the region was cached, its entries
+	// are already included in the resources and ledgers.
+	size_t journalRecordCount = 0;
+	bool hasUnsavedChanges = false;
+};
+
+// Keeps the state of recently visited regions in memory, keyed by the region directory.
+//
+// An entry is only used if the region's data and journal files have the same size
+// and last write time as when the entry was added, otherwise the region is read
+// from disk. The least recently used entries are evicted to stay within the memory budget.
+class RegionStateCache
+{
+public:
+	explicit RegionStateCache(size_t memoryBudget);
+
+	void Insert(
+		const std::filesystem::path& dataFilePath,
+		const std::filesystem::path& journalPath,
+		RegionState&& state);
+
+	// Removes the region's entry from the cache and returns its state.
+	// Returns false if there is no entry or the region's files have changed.
+	bool TryTake(
+		const std::filesystem::path& dataFilePath,
+		const std::filesystem::path& journalPath,
+		RegionState& state);
+
+private:
+	struct FileStamp
+	{
+		bool exists;
+		uintmax_t size;
+		std::filesystem::file_time_type lastWriteTime;
+
+		bool operator==(const FileStamp& other) const = default;
+	};
+
+	struct Entry
+	{
+		std::filesystem::path regionDirectory;
+		FileStamp dataFileStamp;
+		FileStamp journalStamp;
+		size_t memoryUsage;
+		RegionState state;
+	};
+
+	static FileStamp GetFileStamp(const std::filesystem::path& path);
+	static size_t GetMemoryUsage(const RegionState& state);
+
+	void EvictToBudget();
+
+	// The most recently used entry is at the front.
+	std::list<Entry> entries;
+	size_t memoryUsage;
+	size_t memoryBudget;
+	uint64_t hitCount;
+	uint64_t missCount;
+};
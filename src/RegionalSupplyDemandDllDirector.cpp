@@ -19,6 +19,7 @@
  * If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "BuildingResourceCache.h"
 #include "Logger.h"
 #include "version.h"
 #include "cIGZCheatCodeManager.h"
@@ -30,12 +31,12 @@
 #include "cIGZMessage2Standard.h"
 #include "cIGZMessageServer2.h"
 #include "cIGZPersistDBSegment.h"
-#include "cIGZVariant.h"
+#include "cISC4AdvisorSystem.h"
 #include "cISC4App.h"
+#include "cISC4BuildingOccupant.h"
 #include "cISC4City.h"
 #include "cISC4Occupant.h"
 #include "cISC4Region.h"
-#include "cISCProperty.h"
 #include "cISCPropertyHolder.h"
 #include "cISCStringDetokenizer.h"
 #include "cRZAutoRefCount.h"
@@ -44,14 +45,17 @@
 #include "DebugUtil.h"
 #include "GlobalPointers.h"
 #include "GZServPtrs.h"
-#include "PropertyUtil.h"
+#include "Profiler.h"
 #include "RegionalSupplyLua.h"
 #include "RegionalSupplyManager.h"
 #include "SC4String.h"
 #include "SCLuaUtil.h"
 
 #include <array>
+#include <cstdio>
+#include <cstdlib>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <Windows.h>
@@ -61,26 +65,29 @@
 
 static constexpr uint32_t kSC4MessageInsertOccupant = 0x99EF1142;
 static constexpr uint32_t kSC4MessageRemoveOccupant = 0x99EF1143;
+static constexpr uint32_t kSC4MessagePreCityInit = 0x26D31EC0;
 static constexpr uint32_t kSC4MessagePostCityInit = 0x26D31EC1;
 static constexpr uint32_t kSC4MessagePostCityShutdown = 0x26D31EC3;
 static constexpr uint32_t kSC4MessagePostRegionInit = 0xCBB5BB45;
+static constexpr uint32_t kSC4MessageLoad = 0x26C63345;
+static constexpr uint32_t kSC4MessageSave = 0x26C63344;
 
-static constexpr std::array<uint32_t, 5> RequiredNotifications =
+static constexpr std::array<uint32_t, 8> RequiredNotifications =
 {
 	kSC4MessageInsertOccupant,
 	kSC4MessageRemoveOccupant,
+	kSC4MessagePreCityInit,
 	kSC4MessagePostCityInit,
 	kSC4MessagePostCityShutdown,
-	kSC4MessagePostRegionInit
+	kSC4MessagePostRegionInit,
+	kSC4MessageLoad,
+	kSC4MessageSave
 };
 
 static constexpr uint32_t OccupantTypeBuilding = 0x278128A0;
 
 static constexpr uint32_t kRegionalSupplyDemandDllDirector = 0x21E2B214;
 
-static constexpr uint32_t RegionalSupplyConsumed = 0x16F4C223;
-static constexpr uint32_t RegionalSupplyProduced = 0x16F4C224;
-
 static constexpr std::string_view PluginLogFileName = "SC4RegionalSupplyDemand.log";
 static constexpr std::string_view RegionalSupplyDataFileName = "RegionalSupplyData.dat";
 
@@ -116,6 +123,30 @@ namespace
 		PathCombine(path, std::string_view(segment.Data(), segment.Strlen()));
 	}
 
+	// Gets the file name of the city save file that is being loaded or saved.
+	std::string GetCitySaveFileName(cIGZMessage2Standard* pStandardMsg)
+	{
+		std::string fileName;
+
+		cIGZUnknown* pUnknown = static_cast<cIGZUnknown*>(pStandardMsg->GetVoid1());
+		cRZAutoRefCount<cIGZPersistDBSegment> segment;
+
+		if (pUnknown && pUnknown->QueryInterface(GZIID_cIGZPersistDBSegment, segment.AsPPVoid()))
+		{
+			cRZBaseString path;
+
+			if (segment->GetPath(path))
+			{
+				const std::string_view pathView(path.ToChar(), path.Strlen());
+				const size_t separatorIndex = pathView.find_last_of("\\/");
+
+				fileName = pathView.substr(separatorIndex == std::string_view::npos ? 0 : separatorIndex + 1);
+			}
+		}
+
+		return fileName;
+	}
+
 	cRZBaseString GetRegionalSupplyDataPath()
 	{
 		cRZBaseString path;
@@ -142,88 +173,12 @@ namespace
 		return path;
 	}
 
-	struct ResourceEntry
-	{
-		uint32_t id;
-		uint32_t amount;
-	};
-
-	bool GetResourceEntries(const cISCPropertyHolder* pPropertyHolder, uint32_t id, std::vector<ResourceEntry>& entries)
-	{
-		bool result = false;
-
-		entries.clear();
-
-		const cISCProperty* pProperty = pPropertyHolder->GetProperty(id);
-
-		if (pProperty)
-		{
-			const cIGZVariant* pVariant = pProperty->GetPropertyValue();
-
-			if (pVariant)
-			{
-				const uint16_t type = pVariant->GetType();
-
-				if (type == cIGZVariant::Uint32Array)
-				{
-					const uint32_t count = pVariant->GetCount();
-
-					if (count > 0)
-					{
-						if ((count % 2) == 0)
-						{
-							const uint32_t* pData = pVariant->RefUint32();
-
-							entries.reserve(count / 2);
-
-							for (uint32_t i = 0; i < count; i += 2)
-							{
-								uint32_t id = pData[i];
-								uint32_t amount = pData[i + 1];
-
-								entries.emplace_back(id,  amount);
-							}
-
-							result = true;
-						}
-						else
-						{
-							Logger& logger = Logger::GetInstance();
-
-							cRZBaseString displayName;
-
-							if (PropertyUtil::GetDisplayName(pPropertyHolder, displayName))
-							{
-								logger.WriteLineFormatted(
-									LogLevel::Error,
-									"%s has an invalid 0x%08X property, the values must be id/amount pair(s).",
-									displayName.ToChar(),
-									id);
-							}
-							else
-							{
-								logger.WriteLineFormatted(
-									LogLevel::Error,
-									"Invalid 0x%08X property, the values must be id/amount pair(s).",
-									id);
-							}
-						}
-					}
-				}
-			}
-		}
-
-		return result;
-	}
-
 	void RegisterLuaFunction(
 		cISC4AdvisorSystem* pAdvisorSystem,
 		const char* tableName,
 		const char* functionName,
 		lua_CFunction callback)
 	{
-		Logger& logger = Logger::GetInstance();
-
 		SCLuaUtil::RegisterLuaFunctionStatus status = SCLuaUtil::RegisterLuaFunction(
 			pAdvisorSystem,
 			tableName,
@@ -232,8 +187,7 @@ namespace
 
 		if (status == SCLuaUtil::RegisterLuaFunctionStatus::Ok)
 		{
-			logger.WriteLineFormatted(
-				LogLevel::Info,
+			LOG_INFO(
 				"Registered the %s.%s function",
 				tableName,
 				functionName);
@@ -242,8 +196,7 @@ namespace
 		{
 			if (status == SCLuaUtil::RegisterLuaFunctionStatus::NullParameter)
 			{
-				logger.WriteLineFormatted(
-					LogLevel::Info,
+				LOG_INFO(
 					"Failed to register the %s.%s function. "
 					"One or more SCLuaUtil::RegisterLuaFunction parameters were NULL.",
 					tableName,
@@ -251,8 +204,7 @@ namespace
 			}
 			else if (status == SCLuaUtil::RegisterLuaFunctionStatus::TableWrongType)
 			{
-				logger.WriteLineFormatted(
-					LogLevel::Info,
+				LOG_INFO(
 					"Failed to register the %s.%s function. The %s object is not a Lua table.",
 					tableName,
 					functionName,
@@ -260,8 +212,7 @@ namespace
 			}
 			else
 			{
-				logger.WriteLineFormatted(
-					LogLevel::Info,
+				LOG_INFO(
 					"Failed to register the %s.%s function. "
 					"Is RegionalSupplyDemand.dat in the plugins folder?",
 					tableName,
@@ -283,28 +234,95 @@ namespace
 		return result;
 	}
 
-	void DebugTestLuaAPI()
+	void DispatchWatchEvents(std::span<const ResourceWatchList::Event> events)
 	{
+		cISC4AppPtr sc4App;
+
+		if (sc4App)
+		{
+			cISC4City* pCity = sc4App->GetCity();
+
+			if (pCity)
+			{
+				cISC4AdvisorSystem* pAdvisorSystem = pCity->GetAdvisorSystem();
+
+				if (pAdvisorSystem)
+				{
+					cISCLua* pLua = pAdvisorSystem->GetScriptingContext();
+
+					if (pLua)
+					{
+						RegionalSupplyLua::DispatchWatchEvents(pLua, events);
+					}
+				}
+			}
+		}
+	}
+
 #ifdef _DEBUG
+	// A resource id that no plugin uses. The self-test only reads it, so it does not
+	// add the resource to the region or the save file.
+	constexpr uint32_t DebugTestResourceID = 0xD1B6A7C3;
+
+	std::string FormatTestExpression(const char* format, uint32_t resourceID)
+	{
+		char buffer[256]{};
+		std::snprintf(buffer, sizeof(buffer), format, resourceID, resourceID);
+
+		return std::string(buffer);
+	}
+
+	bool CheckLuaNumber(
+		cISCStringDetokenizer& detokenizer,
+		const char* format,
+		double expected)
+	{
+		const std::string expression = FormatTestExpression(format, DebugTestResourceID);
+		const cRZBaseString result = Detokenize(detokenizer, expression);
+		const double actual = std::strtod(result.ToChar(), nullptr);
+
+		if (actual != expected)
+		{
+			DebugUtil::PrintLineToDebugOutputFormatted(
+				"Lua API test failed: %s returned '%s', expected %.0f.",
+				expression.c_str(),
+				result.ToChar(),
+				expected);
+			return false;
+		}
+
+		return true;
+	}
+
+	// Checks that the game's Lua interpreter calls the plugin's functions.
+	// The test only calls the functions that read the region, the tests that change
+	// the resources run in the headless Lua host in the tests folder.
+	void DebugTestLuaAPI()
+	{
 		cISC4AppPtr sc4App;
 
 		cISCStringDetokenizer* pDetokenizer = sc4App->GetStringDetokenizer();
 
 		if (pDetokenizer)
 		{
-			Detokenize(*pDetokenizer, "regional_supply.add_to_demand(1, 50)");
-			Detokenize(*pDetokenizer, "regional_supply.remove_from_demand(1, 25)");
-			Detokenize(*pDetokenizer, "regional_supply.add_to_supply(1, 75)");
-			Detokenize(*pDetokenizer, "regional_supply.remove_from_supply(1, 25)");
+			cISCStringDetokenizer& detokenizer = *pDetokenizer;
+
+			const double quantity = static_cast<double>(spRegionalSupplyManager->GetResourceQuantity(DebugTestResourceID));
+			const double generation = static_cast<double>(spRegionalSupplyManager->GetResourceGeneration(DebugTestResourceID));
+			bool passed = true;
+
+			passed &= CheckLuaNumber(detokenizer, "regional_supply.get_resource_quantity(%u)", quantity);
+			passed &= CheckLuaNumber(detokenizer, "regional_supply.get_resource_quantities({ %u, %u })[2]", quantity);
+			passed &= CheckLuaNumber(detokenizer, "regional_supply.get_generation(%u)", generation);
 
-			cRZBaseString quantity = Detokenize(*pDetokenizer, "regional_supply.get_resource_quantity(1)");
-			DebugUtil::PrintLineToDebugOutput(quantity.ToChar());
+			DebugUtil::PrintLineToDebugOutput(passed ? "Lua API tests passed." : "Lua API tests failed.");
 		}
-#endif // _DEBUG
 	}
+#endif // _DEBUG
 }
 
-IRegionalSupplyManager* spRegionalSupplyManager = nullptr;
+IRegionalSupplyManager2* spRegionalSupplyManager = nullptr;
+ResourceWatchList* spResourceWatchList = nullptr;
 
 class RegionalSupplyDemandDllDirector final : public cRZMessage2COMDirector
 {
@@ -313,9 +331,17 @@ public:
 	RegionalSupplyDemandDllDirector()
 		: regionalSupplyDataPath(),
 		  regionalSupplyManager(),
+		  buildingResourceCache(),
+		  cityLoadBuildingCounts(),
+		  cityID(),
+		  cityLoadInProgress(false),
 		  exitedCity(false)
 	{
 		spRegionalSupplyManager = &regionalSupplyManager;
+		spResourceWatchList = &regionalSupplyManager.GetWatchList();
+		regionalSupplyManager.SetWatchEventHandler(DispatchWatchEvents);
+		// Saving a new snapshot of the region data resets the journal.
+		regionalSupplyManager.SetJournalCompactionHandler([this]() { SaveRegionData(); });
 
 		std::filesystem::path dllFolderPath = GetDllFolderPath();
 
@@ -350,7 +376,11 @@ private:
 			OccupantRemoved(static_cast<cIGZMessage2Standard*>(pMsg));
 			break;
 		case kSC4MessagePostCityShutdown:
-			exitedCity = true;
+			PostCityShutdown();
+			PROFILE_WRITE_SUMMARY();
+			break;
+		case kSC4MessagePreCityInit:
+			PreCityInit();
 			break;
 		case kSC4MessagePostCityInit:
 			PostCityInit(static_cast<cIGZMessage2Standard*>(pMsg));
@@ -358,6 +388,12 @@ private:
 		case kSC4MessagePostRegionInit:
 			PostRegionInit();
 			break;
+		case kSC4MessageLoad:
+			CityLoaded(static_cast<cIGZMessage2Standard*>(pMsg));
+			break;
+		case kSC4MessageSave:
+			CitySaved(static_cast<cIGZMessage2Standard*>(pMsg));
+			break;
 		}
 
 		return true;
@@ -365,29 +401,37 @@ private:
 
 	void OccupantInserted(cIGZMessage2Standard* pStandardMsg)
 	{
+		PROFILE_SCOPE(MessageInsertOccupant);
+
+#ifdef _DEBUG
+		// The occupant messages should not allocate once the building type is in the cache.
+		DebugUtil::ScopedAllocationCheck allocationCheck("OccupantInserted");
+#endif // _DEBUG
+
 		cISC4Occupant* pOccupant = static_cast<cISC4Occupant*>(pStandardMsg->GetVoid1());
 
 		if (pOccupant->GetType() == OccupantTypeBuilding)
 		{
-			const cISCPropertyHolder* pPropertyHolder = pOccupant->AsPropertyHolder();
-
-			std::vector<ResourceEntry> supplyConsumed;
+			cRZAutoRefCount<cISC4BuildingOccupant> buildingOccupant;
 
-			if (GetResourceEntries(pPropertyHolder, RegionalSupplyConsumed, supplyConsumed))
+			if (pOccupant->QueryInterface(GZIID_cISC4BuildingOccupant, buildingOccupant.AsPPVoid()))
 			{
-				for (const auto& entry : supplyConsumed)
-				{
-					regionalSupplyManager.AddToDemand(entry.id, entry.amount);
-				}
-			}
+				const uint32_t buildingType = buildingOccupant->GetBuildingType();
 
-			std::vector<ResourceEntry> supplyProduced;
+				std::span<const ResourceDelta> deltas = buildingResourceCache.GetInsertedDeltas(
+					buildingType,
+					pOccupant->AsPropertyHolder());
 
-			if (GetResourceEntries(pPropertyHolder, RegionalSupplyProduced, supplyProduced))
-			{
-				for (const auto& entry : supplyProduced)
+				if (!deltas.empty())
 				{
-					regionalSupplyManager.AddToSupply(entry.id, entry.amount);
+					if (cityLoadInProgress)
+					{
+						cityLoadBuildingCounts[buildingType]++;
+					}
+					else
+					{
+						regionalSupplyManager.ApplyBuildingDeltas(deltas);
+					}
 				}
 			}
 		}
@@ -395,38 +439,116 @@ private:
 
 	void OccupantRemoved(cIGZMessage2Standard* pStandardMsg)
 	{
+		PROFILE_SCOPE(MessageRemoveOccupant);
+
+#ifdef _DEBUG
+		DebugUtil::ScopedAllocationCheck allocationCheck("OccupantRemoved");
+#endif // _DEBUG
+
 		cISC4Occupant* pOccupant = static_cast<cISC4Occupant*>(pStandardMsg->GetVoid1());
 
 		if (pOccupant->GetType() == OccupantTypeBuilding)
 		{
-			const cISCPropertyHolder* pPropertyHolder = pOccupant->AsPropertyHolder();
-
-			std::vector<ResourceEntry> supplyConsumed;
+			cRZAutoRefCount<cISC4BuildingOccupant> buildingOccupant;
 
-			if (GetResourceEntries(pPropertyHolder, RegionalSupplyConsumed, supplyConsumed))
+			if (pOccupant->QueryInterface(GZIID_cISC4BuildingOccupant, buildingOccupant.AsPPVoid()))
 			{
-				for (const auto& entry : supplyConsumed)
+				const uint32_t buildingType = buildingOccupant->GetBuildingType();
+
+				std::span<const ResourceDelta> deltas = buildingResourceCache.GetRemovedDeltas(
+					buildingType,
+					pOccupant->AsPropertyHolder());
+
+				if (!deltas.empty())
 				{
-					regionalSupplyManager.RemoveFromDemand(entry.id, entry.amount);
+					if (cityLoadInProgress)
+					{
+						cityLoadBuildingCounts[buildingType]--;
+					}
+					else
+					{
+						regionalSupplyManager.ApplyBuildingDeltas(deltas);
+					}
 				}
 			}
+		}
+	}
 
-			std::vector<ResourceEntry> supplyProduced;
+	void PreCityInit()
+	{
+		PROFILE_SCOPE(MessagePreCityInit);
+
+		// The game sends an insert occupant message for every existing building when
+		// a city is loaded. Instead of applying each building's deltas as it arrives,
+		// the buildings are counted by type and the totals are applied once the
+		// city has finished loading.
+		cityLoadBuildingCounts.clear();
+		cityLoadInProgress = true;
+	}
+
+	void BeginCitySession(cISC4City* pCity)
+	{
+		std::vector<ResourceDelta> buildingTotals;
+
+		for (const auto& item : cityLoadBuildingCounts)
+		{
+			const int64_t buildingCount = item.second;
 
-			if (GetResourceEntries(pPropertyHolder, RegionalSupplyProduced, supplyProduced))
+			if (buildingCount != 0)
 			{
-				for (const auto& entry : supplyProduced)
+				for (const ResourceDelta& delta : buildingResourceCache.GetCachedInsertedDeltas(item.first))
 				{
-					regionalSupplyManager.RemoveFromSupply(entry.id, entry.amount);
+					buildingTotals.emplace_back(delta.resourceID, delta.amount * buildingCount);
 				}
 			}
 		}
+
+		cityLoadBuildingCounts.clear();
+
+		cRZBaseString cityName;
+
+		if (pCity)
+		{
+			pCity->GetCityName(cityName);
+		}
+
+		// The fresh building totals are reconciled against the city's ledger, so
+		// reloading a city does not add its buildings to the region a second time.
+		regionalSupplyManager.BeginCitySession(
+			cityID,
+			std::string_view(cityName.ToChar(), cityName.Strlen()),
+			buildingTotals);
+	}
+
+	void CityLoaded(cIGZMessage2Standard* pStandardMsg)
+	{
+		// The city ledgers are keyed by the save file name, unlike the city name
+		// it is unique within the region and it does not change when the city is renamed.
+		cityID = GetCitySaveFileName(pStandardMsg);
+	}
+
+	void CitySaved(cIGZMessage2Standard* pStandardMsg)
+	{
+		if (cityID.empty())
+		{
+			// A new city does not have a save file until it is saved for the first time.
+			cityID = GetCitySaveFileName(pStandardMsg);
+			regionalSupplyManager.AssignActiveCityID(cityID);
+		}
 	}
 
 	void PostCityInit(cIGZMessage2Standard* pStandardMsg)
 	{
+		PROFILE_SCOPE(MessagePostCityInit);
+
 		cISC4City* pCity = static_cast<cISC4City*>(pStandardMsg->GetVoid1());
 
+		if (cityLoadInProgress)
+		{
+			cityLoadInProgress = false;
+			BeginCitySession(pCity);
+		}
+
 		if (pCity)
 		{
 			cISC4AdvisorSystem* pAdvisorSystem = pCity->GetAdvisorSystem();
@@ -435,31 +557,14 @@ private:
 			{
 				const char* const tableName = "regional_supply";
 
-				RegisterLuaFunction(
-					pAdvisorSystem,
-					tableName,
-					"add_to_demand",
-					RegionalSupplyLua::AddToDemand);
-				RegisterLuaFunction(
-					pAdvisorSystem,
-					tableName,
-					"remove_from_demand",
-					RegionalSupplyLua::RemoveFromDemand);
-				RegisterLuaFunction(
-					pAdvisorSystem,
-					tableName,
-					"add_to_supply",
-					RegionalSupplyLua::AddToSupply);
-				RegisterLuaFunction(
-					pAdvisorSystem,
-					tableName,
-					"remove_from_supply",
-					RegionalSupplyLua::RemoveFromSupply);
-				RegisterLuaFunction(
-					pAdvisorSystem,
-					tableName,
-					"get_resource_quantity",
-					RegionalSupplyLua::GetResourceQuantity);
+				for (const RegionalSupplyLua::Function& function : RegionalSupplyLua::GetFunctions())
+				{
+					RegisterLuaFunction(
+						pAdvisorSystem,
+						tableName,
+						function.name,
+						function.callback);
+				}
 
 #ifdef _DEBUG
 				DebugTestLuaAPI();
@@ -468,8 +573,26 @@ private:
 		}
 	}
 
+	void PostCityShutdown()
+	{
+		PROFILE_SCOPE(MessagePostCityShutdown);
+
+		// Discard the building counts if the city shut down before it finished loading.
+		cityLoadInProgress = false;
+		cityLoadBuildingCounts.clear();
+		regionalSupplyManager.EndCitySession();
+		regionalSupplyManager.FlushJournal();
+		cityID.clear();
+		// The watch callbacks belong to the city's Lua scripts.
+		regionalSupplyManager.GetWatchList().Clear();
+		buildingResourceCache.WriteInvalidPropertySummary();
+		exitedCity = true;
+	}
+
 	void PostRegionInit()
 	{
+		PROFILE_SCOPE(MessagePostRegionInit);
+
 		if (exitedCity)
 		{
 			exitedCity = false;
@@ -484,10 +607,12 @@ private:
 
 	void LoadRegionData()
 	{
+		cRZAutoRefCount<cIGZPersistDBSegment> segment;
+		cIGZPersistDBSegment* pDataSegment = nullptr;
+		std::filesystem::path dataFilePath;
+
 		if (regionalSupplyDataPath.Strlen() > 0)
 		{
-			cRZAutoRefCount<cIGZPersistDBSegment> segment;
-
 			if (mpCOM->GetClassObject(
 				GZCLSID_cGZDBSegmentPackedFile,
 				GZIID_cIGZPersistDBSegment,
@@ -495,18 +620,22 @@ private:
 			{
 				if (segment->Init() && segment->SetPath(regionalSupplyDataPath))
 				{
-					if (segment->Open(true, false))
-					{
-						regionalSupplyManager.Load(segment);
-					}
+					pDataSegment = segment;
 				}
 			}
+
+			dataFilePath = std::filesystem::path(std::string_view(regionalSupplyDataPath.ToChar(), regionalSupplyDataPath.Strlen()));
 		}
+
+		// The data file is opened and parsed on a worker thread, the manager
+		// methods wait for it if they are called before the data is ready.
+		regionalSupplyManager.LoadAsync(pDataSegment, dataFilePath);
 	}
 
 	void SaveRegionData()
 	{
-		if (regionalSupplyDataPath.Strlen() > 0)
+		// The data file is only rewritten when the resource data changed.
+		if (regionalSupplyDataPath.Strlen() > 0 && regionalSupplyManager.CheckForUnsavedChanges())
 		{
 			cRZAutoRefCount<cIGZPersistDBSegment> segment;
 
@@ -517,10 +646,26 @@ private:
 			{
 				if (segment->Init() && segment->SetPath(regionalSupplyDataPath))
 				{
-					if (segment->Open(true, true))
-					{
-						regionalSupplyManager.Save(segment);
-					}
+					// The segment is opened and written on a worker thread, this keeps
+					// the save out of the transition from the city to the region view.
+					regionalSupplyManager.SaveAsync(
+						segment,
+						[](const RegionalSupplyManager::SaveResult& result)
+						{
+							if (result.unchanged)
+							{
+								LOG_INFO(
+									"The region resource data matches the saved data, the game thread was blocked for %.2f ms.",
+									result.snapshotMilliseconds);
+							}
+							else if (result.succeeded)
+							{
+								LOG_INFO(
+									"Saved the region resource data in %.2f ms, the game thread was blocked for %.2f ms.",
+									result.snapshotMilliseconds + result.writeMilliseconds,
+									result.snapshotMilliseconds);
+							}
+						});
 				}
 			}
 		}
@@ -528,24 +673,56 @@ private:
 
 	bool PostAppInit()
 	{
-		Logger& logger = Logger::GetInstance();
-
 		cIGZMessageServer2Ptr ms2;
 
 		for (uint32_t messageID : RequiredNotifications)
 		{
 			if (!ms2->AddNotification(this, messageID))
 			{
-				logger.WriteLine(LogLevel::Error, "Failed to subscribe to the required notifications.");
+				LOG_ERROR("Failed to subscribe to the required notifications.");
 				return false;
 			}
 		}
 
+		if (mpFrameWork->AddSystemService(&regionalSupplyManager))
+		{
+			// The service tick sends the Lua watch events.
+			mpFrameWork->AddToTick(&regionalSupplyManager);
+		}
+		else
+		{
+			// The Lua API does not depend on the system service, so this is not a fatal error.
+			LOG_ERROR("Failed to register the regional supply system service.");
+		}
+
+		return true;
+	}
+
+	bool PreAppShutdown()
+	{
+		regionalSupplyManager.WaitForPendingSave();
+		regionalSupplyManager.CloseJournal();
+		return true;
+	}
+
+	bool PostAppShutdown()
+	{
+		mpFrameWork->RemoveFromTick(&regionalSupplyManager);
+		mpFrameWork->RemoveSystemService(&regionalSupplyManager);
+
+		// Write the queued log lines before the DLL is unloaded.
+		Logger::GetInstance().Shutdown();
 		return true;
 	}
 
 	cRZBaseString regionalSupplyDataPath;
 	RegionalSupplyManager regionalSupplyManager;
+	BuildingResourceCache buildingResourceCache;
+	// The number of buildings of each type that were added while the city was loading.
+	std::unordered_map<uint32_t, int64_t> cityLoadBuildingCounts;
+	// The save file name of the current city, this is empty until a new city is saved.
+	std::string cityID;
+	bool cityLoadInProgress;
 	bool exitedCity;
 };
 
@@ -0,0 +1,635 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RegionalSupplyJournal.h"
+#include "Logger.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace
+{
+	constexpr uint32_t JournalSignature = 0x4A445352; // RSDJ
+	// Version 2 identifies the cities by their save file name instead of their display name.
+	constexpr uint32_t JournalVersion = 2;
+
+	// The city name follows a CityBegin or CityRename record, split across as many chunk
+	// records as needed.
+	constexpr uint32_t CityNameChunkRecordType = 4;
+	constexpr size_t CityNameChunkSize = 12;
+
+	// The writer thread is woken each time this many records have been queued.
+	constexpr size_t JournalBatchSize = 256;
+
+	// The number of records that the ring buffer can hold, this must be a power of 2.
+	constexpr size_t QueueCapacity = 4096;
+	constexpr size_t QueueIndexMask = QueueCapacity - 1;
+
+	static_assert((QueueCapacity & QueueIndexMask) == 0);
+
+	// The maximum number of delta records that AppendDeltas builds on the stack at a time.
+	constexpr size_t DeltaRecordBatchSize = 64;
+
+	struct JournalHeader
+	{
+		uint32_t signature;
+		uint32_t version;
+		uint32_t snapshotSequence;
+		uint32_t reserved;
+	};
+
+	static_assert(sizeof(JournalHeader) == 16);
+
+	bool ReadJournalHeader(std::ifstream& input, uint32_t snapshotSequence, JournalHeader& header)
+	{
+		return input.read(reinterpret_cast<char*>(&header), sizeof(header))
+			&& header.signature == JournalSignature
+			&& header.version >= 1
+			&& header.version <= JournalVersion
+			&& header.snapshotSequence == snapshotSequence;
+	}
+}
+
+RegionalSupplyJournal::RegionalSupplyJournal()
+	: mutex(),
+	  path(),
+	  file(),
+	  writtenRecordCount(0),
+	  dequeuePosition(0),
+	  drainedRecords(),
+	  queue(std::make_unique<QueueSlot[]>(QueueCapacity)),
+	  enqueuePosition(0),
+	  fileBasePosition(0),
+	  acceptingRecords(false),
+	  wakeCounter(0),
+	  stopRequested(false),
+	  writerThread()
+{
+	for (size_t i = 0; i < QueueCapacity; i++)
+	{
+		queue[i].sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+RegionalSupplyJournal::~RegionalSupplyJournal()
+{
+	Close();
+}
+
+bool RegionalSupplyJournal::Open(
+	const std::filesystem::path& journalPath,
+	uint32_t snapshotSequence,
+	std::vector<ReplayEntry>& replayEntries,
+	bool& hasLegacyCityNames)
+{
+	std::scoped_lock lock(mutex);
+
+	hasLegacyCityNames = false;
+	replayEntries.clear();
+
+	ResetForOpenLocked(journalPath);
+
+	std::ifstream input(path, std::ifstream::in | std::ifstream::binary);
+
+	if (input)
+	{
+		JournalHeader header{};
+
+		if (ReadJournalHeader(input, snapshotSequence, header))
+		{
+			hasLegacyCityNames = header.version == 1;
+
+			Record record{};
+			EntryType pendingCityEntryType = EntryType::CityBegin;
+			std::string pendingCityName;
+			size_t pendingCityNameLength = 0;
+
+			// A partial record at the end of the file is the result of an interrupted
+			// write, it is ignored and then truncated below.
+			while (input.read(reinterpret_cast<char*>(&record), sizeof(record)))
+			{
+				if (record.type == CityNameChunkRecordType)
+				{
+					const size_t remaining = pendingCityNameLength - pendingCityName.size();
+
+					pendingCityName.append(
+						reinterpret_cast<const char*>(record.payload),
+						std::min(remaining, CityNameChunkSize));
+
+					if (pendingCityName.size() == pendingCityNameLength)
+					{
+						replayEntries.emplace_back(pendingCityEntryType, ResourceDelta{}, std::move(pendingCityName));
+						pendingCityName.clear();
+						pendingCityNameLength = 0;
+					}
+				}
+				else if (record.type == static_cast<uint32_t>(EntryType::CityBegin)
+					|| record.type == static_cast<uint32_t>(EntryType::CityRename))
+				{
+					uint32_t nameLength = 0;
+					std::memcpy(&nameLength, record.payload, sizeof(nameLength));
+
+					pendingCityEntryType = static_cast<EntryType>(record.type);
+					pendingCityName.clear();
+					pendingCityNameLength = nameLength;
+
+					if (nameLength == 0)
+					{
+						replayEntries.emplace_back(pendingCityEntryType, ResourceDelta{}, std::string());
+					}
+				}
+				else
+				{
+					ResourceDelta delta{};
+					std::memcpy(&delta.resourceID, record.payload, sizeof(delta.resourceID));
+					std::memcpy(&delta.amount, record.payload + sizeof(delta.resourceID), sizeof(delta.amount));
+
+					replayEntries.emplace_back(static_cast<EntryType>(record.type), delta, std::string());
+				}
+
+				writtenRecordCount++;
+			}
+		}
+
+		input.close();
+	}
+
+	if (writtenRecordCount > 0)
+	{
+		std::error_code ec;
+		std::filesystem::resize_file(
+			path,
+			sizeof(JournalHeader) + (writtenRecordCount * sizeof(Record)),
+			ec);
+
+		if (!ec)
+		{
+			file.open(path, std::ofstream::out | std::ofstream::binary | std::ofstream::app);
+		}
+	}
+
+	if (!file.is_open())
+	{
+		replayEntries.clear();
+
+		if (!StartNewFileLocked(snapshotSequence))
+		{
+			acceptingRecords.store(false, std::memory_order_release);
+			UpdateFileBasePositionLocked();
+
+			LOG_ERROR(
+				"Failed to open the region resource journal.");
+			return false;
+		}
+	}
+
+	StartAcceptingRecordsLocked();
+
+	return true;
+}
+
+bool RegionalSupplyJournal::OpenForAppend(
+	const std::filesystem::path& journalPath,
+	uint32_t snapshotSequence,
+	size_t recordCount)
+{
+	std::scoped_lock lock(mutex);
+
+	ResetForOpenLocked(journalPath);
+
+	{
+		std::ifstream input(path, std::ifstream::in | std::ifstream::binary);
+		JournalHeader header{};
+
+		if (!input || !ReadJournalHeader(input, snapshotSequence, header))
+		{
+			return false;
+		}
+	}
+
+	// A size mismatch means that a record write failed or the file was changed
+	// after the journal was closed.
+	std::error_code ec;
+	const uintmax_t fileSize = std::filesystem::file_size(path, ec);
+
+	if (ec || fileSize != sizeof(JournalHeader) + (recordCount * sizeof(Record)))
+	{
+		return false;
+	}
+
+	file.open(path, std::ofstream::out | std::ofstream::binary | std::ofstream::app);
+
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	writtenRecordCount = recordCount;
+	StartAcceptingRecordsLocked();
+
+	return true;
+}
+
+size_t RegionalSupplyJournal::Close()
+{
+	acceptingRecords.store(false, std::memory_order_release);
+
+	// The writer thread takes the mutex, so it is stopped before the mutex is locked.
+	StopWriterThread();
+
+	std::scoped_lock lock(mutex);
+
+	if (file.is_open())
+	{
+		DrainQueueLocked(true);
+		file.close();
+	}
+
+	const size_t recordCount = writtenRecordCount;
+
+	writtenRecordCount = 0;
+	UpdateFileBasePositionLocked();
+
+	return recordCount;
+}
+
+void RegionalSupplyJournal::Rewrite(uint32_t snapshotSequence, const std::vector<ReplayEntry>& entries)
+{
+	std::scoped_lock lock(mutex);
+
+	if (file.is_open())
+	{
+		file.close();
+		DrainQueueLocked(false);
+
+		if (StartNewFileLocked(snapshotSequence))
+		{
+			std::vector<Record> records;
+
+			for (const ReplayEntry& entry : entries)
+			{
+				if (entry.type == EntryType::CityBegin || entry.type == EntryType::CityRename)
+				{
+					BuildNamedRecords(entry.type, entry.cityName, records);
+				}
+				else
+				{
+					Record& record = records.emplace_back();
+					record.type = static_cast<uint32_t>(entry.type);
+					std::memcpy(record.payload, &entry.delta.resourceID, sizeof(entry.delta.resourceID));
+					std::memcpy(record.payload + sizeof(entry.delta.resourceID), &entry.delta.amount, sizeof(entry.delta.amount));
+				}
+			}
+
+			WriteRecordsLocked(records.data(), records.size());
+		}
+
+		UpdateFileBasePositionLocked();
+	}
+}
+
+void RegionalSupplyJournal::Rebase(uint32_t snapshotSequence, size_t firstEntryIndex, const std::string* pActiveCityName)
+{
+	std::scoped_lock lock(mutex);
+
+	if (file.is_open())
+	{
+		// The records that are queued after this point are written to the new file.
+		DrainQueueLocked(true);
+		file.close();
+
+		std::vector<Record> keptRecords;
+
+		if (firstEntryIndex < writtenRecordCount)
+		{
+			keptRecords.resize(writtenRecordCount - firstEntryIndex);
+
+			std::ifstream input(path, std::ifstream::in | std::ifstream::binary);
+
+			input.seekg(sizeof(JournalHeader) + (firstEntryIndex * sizeof(Record)));
+			input.read(
+				reinterpret_cast<char*>(keptRecords.data()),
+				static_cast<std::streamsize>(keptRecords.size() * sizeof(Record)));
+
+			if (!input)
+			{
+				LOG_ERROR(
+					"Failed to read the region resource journal.");
+				keptRecords.clear();
+			}
+		}
+
+		if (StartNewFileLocked(snapshotSequence))
+		{
+			std::vector<Record> records;
+
+			// The kept building entries belong to the city that was active when the snapshot was taken.
+			if (pActiveCityName)
+			{
+				BuildNamedRecords(EntryType::CityBegin, *pActiveCityName, records);
+			}
+
+			records.insert(records.end(), keptRecords.begin(), keptRecords.end());
+
+			WriteRecordsLocked(records.data(), records.size());
+		}
+
+		UpdateFileBasePositionLocked();
+	}
+}
+
+void RegionalSupplyJournal::AppendDeltas(EntryType type, const ResourceDelta* pDeltas, size_t count)
+{
+	if (!acceptingRecords.load(std::memory_order_acquire))
+	{
+		return;
+	}
+
+	std::array<Record, DeltaRecordBatchSize> records;
+
+	for (size_t offset = 0; offset < count; offset += records.size())
+	{
+		const size_t batchCount = std::min(records.size(), count - offset);
+
+		for (size_t i = 0; i < batchCount; i++)
+		{
+			const ResourceDelta& delta = pDeltas[offset + i];
+
+			Record& record = records[i];
+			record.type = static_cast<uint32_t>(type);
+			std::memcpy(record.payload, &delta.resourceID, sizeof(delta.resourceID));
+			std::memcpy(record.payload + sizeof(delta.resourceID), &delta.amount, sizeof(delta.amount));
+		}
+
+		AppendRecords(records.data(), batchCount);
+	}
+}
+
+void RegionalSupplyJournal::AppendCityBegin(std::string_view cityName)
+{
+	if (acceptingRecords.load(std::memory_order_acquire))
+	{
+		std::vector<Record> records;
+		BuildNamedRecords(EntryType::CityBegin, cityName, records);
+
+		AppendRecords(records.data(), records.size());
+	}
+}
+
+void RegionalSupplyJournal::AppendCityRename(std::string_view cityName)
+{
+	if (acceptingRecords.load(std::memory_order_acquire))
+	{
+		std::vector<Record> records;
+		BuildNamedRecords(EntryType::CityRename, cityName, records);
+
+		AppendRecords(records.data(), records.size());
+	}
+}
+
+void RegionalSupplyJournal::Flush()
+{
+	std::scoped_lock lock(mutex);
+
+	DrainQueueLocked(true);
+}
+
+size_t RegionalSupplyJournal::GetEntryCount() const
+{
+	return enqueuePosition.load(std::memory_order_acquire) - fileBasePosition.load(std::memory_order_acquire);
+}
+
+void RegionalSupplyJournal::BuildNamedRecords(EntryType type, std::string_view cityName, std::vector<Record>& records)
+{
+	const uint32_t nameLength = static_cast<uint32_t>(cityName.size());
+
+	Record& record = records.emplace_back();
+	record.type = static_cast<uint32_t>(type);
+	std::memcpy(record.payload, &nameLength, sizeof(nameLength));
+
+	for (size_t offset = 0; offset < cityName.size(); offset += CityNameChunkSize)
+	{
+		Record& chunk = records.emplace_back();
+		chunk.type = CityNameChunkRecordType;
+		std::memcpy(
+			chunk.payload,
+			cityName.data() + offset,
+			std::min(CityNameChunkSize, cityName.size() - offset));
+	}
+}
+
+void RegionalSupplyJournal::AppendRecords(const Record* pRecords, size_t count)
+{
+	// A name that is longer than the ring buffer is split across several claims.
+	while (count > QueueCapacity)
+	{
+		AppendRecords(pRecords, QueueCapacity);
+
+		pRecords += QueueCapacity;
+		count -= QueueCapacity;
+	}
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	// A bounded multi-producer queue, each slot has a sequence number that tells
+	// the producers which lap of the ring buffer it is free for.
+	// The writer frees the slots in order, so the range is free when its last slot is.
+	size_t position = enqueuePosition.load(std::memory_order_relaxed);
+
+	while (true)
+	{
+		const size_t lastPosition = position + count - 1;
+		const size_t sequence = queue[lastPosition & QueueIndexMask].sequence.load(std::memory_order_acquire);
+		const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(lastPosition);
+
+		if (difference == 0)
+		{
+			if (enqueuePosition.compare_exchange_weak(position, position + count, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		else if (difference < 0)
+		{
+			// The writer thread has not written the records from the previous lap.
+			WakeWriterThread();
+			std::this_thread::yield();
+			position = enqueuePosition.load(std::memory_order_relaxed);
+		}
+		else
+		{
+			position = enqueuePosition.load(std::memory_order_relaxed);
+		}
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		QueueSlot& slot = queue[(position + i) & QueueIndexMask];
+
+		slot.record = pRecords[i];
+		slot.sequence.store(position + i + 1, std::memory_order_release);
+	}
+
+	if ((position / JournalBatchSize) != ((position + count) / JournalBatchSize))
+	{
+		WakeWriterThread();
+	}
+}
+
+void RegionalSupplyJournal::WakeWriterThread()
+{
+	wakeCounter.fetch_add(1, std::memory_order_release);
+	wakeCounter.notify_one();
+}
+
+void RegionalSupplyJournal::StopWriterThread()
+{
+	if (writerThread.joinable())
+	{
+		stopRequested.store(true, std::memory_order_release);
+		WakeWriterThread();
+
+		writerThread.join();
+		stopRequested.store(false, std::memory_order_release);
+	}
+}
+
+void RegionalSupplyJournal::WriterThreadProc()
+{
+	while (true)
+	{
+		const uint32_t observedWakeCounter = wakeCounter.load(std::memory_order_acquire);
+
+		{
+			std::scoped_lock lock(mutex);
+
+			DrainQueueLocked(true);
+		}
+
+		if (stopRequested.load(std::memory_order_acquire))
+		{
+			break;
+		}
+
+		wakeCounter.wait(observedWakeCounter, std::memory_order_acquire);
+	}
+}
+
+void RegionalSupplyJournal::DrainQueueLocked(bool writeRecords)
+{
+	drainedRecords.clear();
+
+	while (true)
+	{
+		QueueSlot& slot = queue[dequeuePosition & QueueIndexMask];
+
+		if (slot.sequence.load(std::memory_order_acquire) != (dequeuePosition + 1))
+		{
+			break;
+		}
+
+		drainedRecords.push_back(slot.record);
+
+		// Make the slot available to the producers on the next lap.
+		slot.sequence.store(dequeuePosition + QueueCapacity, std::memory_order_release);
+		dequeuePosition++;
+	}
+
+	if (writeRecords && file.is_open())
+	{
+		WriteRecordsLocked(drainedRecords.data(), drainedRecords.size());
+	}
+	else
+	{
+		// The discarded records are not part of the file.
+		UpdateFileBasePositionLocked();
+	}
+}
+
+void RegionalSupplyJournal::WriteRecordsLocked(const Record* pRecords, size_t count)
+{
+	if (file.is_open() && count > 0)
+	{
+		file.write(
+			reinterpret_cast<const char*>(pRecords),
+			static_cast<std::streamsize>(count * sizeof(Record)));
+		file.flush();
+
+		writtenRecordCount += count;
+	}
+}
+
+bool RegionalSupplyJournal::StartNewFileLocked(uint32_t snapshotSequence)
+{
+	writtenRecordCount = 0;
+
+	file.open(path, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+
+	if (file)
+	{
+		JournalHeader header{};
+		header.signature = JournalSignature;
+		header.version = JournalVersion;
+		header.snapshotSequence = snapshotSequence;
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.flush();
+	}
+
+	return file.good();
+}
+
+void RegionalSupplyJournal::ResetForOpenLocked(const std::filesystem::path& journalPath)
+{
+	if (file.is_open())
+	{
+		DrainQueueLocked(true);
+		file.close();
+	}
+
+	// Records that were appended after the previous journal was closed do not
+	// belong to this journal.
+	DrainQueueLocked(false);
+
+	path = journalPath;
+	writtenRecordCount = 0;
+}
+
+void RegionalSupplyJournal::StartAcceptingRecordsLocked()
+{
+	UpdateFileBasePositionLocked();
+	acceptingRecords.store(true, std::memory_order_release);
+
+	if (!writerThread.joinable())
+	{
+		writerThread = std::thread(&RegionalSupplyJournal::WriterThreadProc, this);
+	}
+}
+
+void RegionalSupplyJournal::UpdateFileBasePositionLocked()
+{
+	// The records that are still queued are counted by GetEntryCount, the
+	// records in the file are counted by writtenRecordCount.
+	fileBasePosition.store(dequeuePosition - writtenRecordCount, std::memory_order_release);
+}
@@ -0,0 +1,161 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include "IRegionalSupplyManager.h"
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// An append-only log of the resource changes made since the last region data snapshot.
+//
+// The journal is stored next to RegionalSupplyData.dat as a header followed by
+// fixed-size 16 byte records. The header stores the sequence number of the snapshot
+// that the journal applies to, a journal with a different sequence number is
+// discarded when it is opened.
+//
+// The appended records are queued in a fixed-size ring buffer that a background
+// thread writes to the file in batches, so the appending threads do not take a
+// lock or wait for the file. If the ring buffer is full the appending thread
+// waits for the background thread to make space, the records are never dropped.
+class RegionalSupplyJournal
+{
+public:
+	enum class EntryType : uint32_t
+	{
+		// A change to the region totals.
+		RegionDelta = 1,
+		// A building change that is applied to the region totals and the active city's ledger.
+		BuildingDelta = 2,
+		// Makes the named city the active city for the BuildingDelta entries that follow it.
+		CityBegin = 3,
+		// Moves the active city's ledger to the named city, which becomes the active city.
+		CityRename = 5,
+	};
+
+	struct ReplayEntry
+	{
+		EntryType type;
+		ResourceDelta delta;
+		std::string cityName;
+	};
+
+	RegionalSupplyJournal();
+	~RegionalSupplyJournal();
+
+	// Opens the journal for writing.
+	// If the existing journal matches the snapshot sequence number its entries are
+	// returned in replayEntries, otherwise the journal is restarted.
+	// hasLegacyCityNames is set to true if the journal was written by a version of
+	// the plugin that identified the cities by their display name.
+	bool Open(
+		const std::filesystem::path& path,
+		uint32_t snapshotSequence,
+		std::vector<ReplayEntry>& replayEntries,
+		bool& hasLegacyCityNames);
+	// Opens a journal that was already replayed for appending, without reading its records.
+	// recordCount is the number of records that the journal had when it was closed, it
+	// is checked against the file size. Returns false if the file does not match, the
+	// caller should open the journal with Open in that case.
+	bool OpenForAppend(const std::filesystem::path& path, uint32_t snapshotSequence, size_t recordCount);
+	// Closes the journal and returns the number of records in the file.
+	size_t Close();
+
+	// Restarts the journal in the current format with the specified entries.
+	void Rewrite(uint32_t snapshotSequence, const std::vector<ReplayEntry>& entries);
+
+	// Restarts the journal for a new snapshot that was taken when the journal had
+	// firstEntryIndex entries, the entries that were added after that point are kept.
+	// pActiveCityName is the city that was active when the snapshot was taken, or
+	// nullptr if no city was active.
+	void Rebase(uint32_t snapshotSequence, size_t firstEntryIndex, const std::string* pActiveCityName);
+
+	void AppendDeltas(EntryType type, const ResourceDelta* pDeltas, size_t count);
+	void AppendCityBegin(std::string_view cityName);
+	void AppendCityRename(std::string_view cityName);
+
+	// Writes the queued entries to the file on the calling thread.
+	void Flush();
+
+	// Gets the number of entries in the journal, including the queued entries.
+	size_t GetEntryCount() const;
+
+private:
+	struct Record
+	{
+		uint32_t type;
+		uint8_t payload[12];
+	};
+
+	static_assert(sizeof(Record) == 16);
+
+	struct QueueSlot
+	{
+		// Used by the appending threads and the writer to find out if the
+		// slot is free or holds a record that has not been written yet.
+		std::atomic<size_t> sequence;
+		Record record;
+	};
+
+	static void BuildNamedRecords(EntryType type, std::string_view cityName, std::vector<Record>& records);
+
+	// Queues the records in consecutive ring buffer slots.
+	void AppendRecords(const Record* pRecords, size_t count);
+	void WakeWriterThread();
+	void StopWriterThread();
+	void WriterThreadProc();
+
+	// The methods below must be called with the mutex held.
+
+	// Moves the queued records to the file, or discards them if writeRecords is false.
+	void DrainQueueLocked(bool writeRecords);
+	void WriteRecordsLocked(const Record* pRecords, size_t count);
+	bool StartNewFileLocked(uint32_t snapshotSequence);
+	// Closes the current file and discards the queued records of the previous journal.
+	void ResetForOpenLocked(const std::filesystem::path& journalPath);
+	void StartAcceptingRecordsLocked();
+	void UpdateFileBasePositionLocked();
+
+	// Held by the thread that writes to the file or drains the queue.
+	mutable std::mutex mutex;
+	std::filesystem::path path;
+	std::ofstream file;
+	size_t writtenRecordCount;
+	size_t dequeuePosition;
+	std::vector<Record> drainedRecords;
+
+	std::unique_ptr<QueueSlot[]> queue;
+	std::atomic<size_t> enqueuePosition;
+	// The queue position that corresponds to the first record in the file,
+	// lets GetEntryCount run without taking the mutex.
+	std::atomic<size_t> fileBasePosition;
+	std::atomic<bool> acceptingRecords;
+	// Incremented when a batch of records is queued, the writer thread waits for it to change.
+	std::atomic<uint32_t> wakeCounter;
+	std::atomic<bool> stopRequested;
+	std::thread writerThread;
+};
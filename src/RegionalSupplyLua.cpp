@@ -21,143 +21,265 @@
 
 #include "RegionalSupplyLua.h"
 #include "GlobalPointers.h"
+#include "Logger.h"
+#include "LuaBinding.h"
+#include "Profiler.h"
 #include "SCLuaUtil.h"
-#include <limits>
+#include <array>
+#include <vector>
 
 namespace
 {
-	bool TryGetNumberAsUint32(cISCLua* pLua, int32_t index, uint32_t& value)
+	// Most scripts pass a few deltas per call, these are read into a stack
+	// buffer. Larger tables continue in a heap buffer.
+	constexpr size_t MaxStackResourceDeltas = 64;
+
+	// Reads a { resourceID, amount } pair from the table at the top of the stack.
+	bool TryGetResourceDelta(cISCLua* pLua, ResourceDelta& delta)
 	{
-		if (pLua->Type(index) != cIGZLua5Thread::LuaTypeNumber)
+		if (pLua->Type(-1) != cIGZLua5Thread::LuaTypeTable)
 		{
-			value = 0;
 			return false;
 		}
 
-		double number = pLua->ToNumber(index);
+		pLua->RawGetI(-1, 1);
+		pLua->RawGetI(-2, 2);
 
-		if (value < std::numeric_limits<uint32_t>::min()
-			|| value > std::numeric_limits<uint32_t>::max())
-		{
-			value = 0;
-			return false;
-		}
+		bool result = LuaBinding::TryGetNumber(pLua, -2, delta.resourceID)
+			       && LuaBinding::TryGetNumber(pLua, -1, delta.amount);
 
-		value = static_cast<uint32_t>(number);
-		return true;
+		pLua->SetTop(-3);
+
+		return result;
 	}
+
+	using LuaBinding::MethodThunk;
+
+#if REGIONAL_SUPPLY_PROFILING
+	template <Profiler::Scope scope, auto Function> int32_t ProfiledFunction(lua_State* pState)
+	{
+		const Profiler::ScopedTimer timer(scope);
+
+		return Function(pState);
+	}
+
+#define PROFILED_LUA_FUNCTION(scope, function) ProfiledFunction<Profiler::Scope::scope, function>
+#else
+#define PROFILED_LUA_FUNCTION(scope, function) function
+#endif // REGIONAL_SUPPLY_PROFILING
+
+	constexpr auto Functions = std::to_array<RegionalSupplyLua::Function>(
+	{
+		{ "add_to_demand", PROFILED_LUA_FUNCTION(LuaAddToDemand, (MethodThunk<&spRegionalSupplyManager, &IRegionalSupplyManager::AddToDemand>)) },
+		{ "remove_from_demand", PROFILED_LUA_FUNCTION(LuaRemoveFromDemand, (MethodThunk<&spRegionalSupplyManager, &IRegionalSupplyManager::RemoveFromDemand>)) },
+		{ "add_to_supply", PROFILED_LUA_FUNCTION(LuaAddToSupply, (MethodThunk<&spRegionalSupplyManager, &IRegionalSupplyManager::AddToSupply>)) },
+		{ "remove_from_supply", PROFILED_LUA_FUNCTION(LuaRemoveFromSupply, (MethodThunk<&spRegionalSupplyManager, &IRegionalSupplyManager::RemoveFromSupply>)) },
+		{ "get_resource_quantity", PROFILED_LUA_FUNCTION(LuaGetResourceQuantity, (MethodThunk<&spRegionalSupplyManager, &IRegionalSupplyManager::GetResourceQuantity>)) },
+		{ "get_generation", PROFILED_LUA_FUNCTION(LuaGetGeneration, RegionalSupplyLua::GetGeneration) },
+		{ "get_resource_quantities", PROFILED_LUA_FUNCTION(LuaGetResourceQuantities, RegionalSupplyLua::GetResourceQuantities) },
+		{ "apply_deltas", PROFILED_LUA_FUNCTION(LuaApplyDeltas, RegionalSupplyLua::ApplyDeltas) },
+		{ "watch", PROFILED_LUA_FUNCTION(LuaWatch, RegionalSupplyLua::Watch) },
+	});
 }
 
-int32_t RegionalSupplyLua::AddToDemand(lua_State* pState)
+std::span<const RegionalSupplyLua::Function> RegionalSupplyLua::GetFunctions()
+{
+	return Functions;
+}
+
+int32_t RegionalSupplyLua::GetGeneration(lua_State* pState)
 {
 	cRZAutoRefCount<cISCLua> lua = SCLuaUtil::GetISCLuaFromFunctionState(pState);
 
+	uint64_t generation = 0;
+
 	int32_t parameterCount = lua->GetTop();
 
-	if (parameterCount == 2)
+	if (parameterCount == 0)
+	{
+		generation = spRegionalSupplyManager->GetGeneration();
+	}
+	else if (parameterCount == 1)
 	{
-		uint32_t amount = 0;
 		uint32_t resourceID = 0;
 
-		// Function parameters are popped off the stack in right-to-left order.
-
-		if (TryGetNumberAsUint32(lua, -1, amount)
-			&& TryGetNumberAsUint32(lua, -2, resourceID))
+		if (LuaBinding::TryGetNumber(lua, -1, resourceID))
 		{
-			spRegionalSupplyManager->AddToDemand(resourceID, amount);
+			generation = spRegionalSupplyManager->GetResourceGeneration(resourceID);
 		}
 	}
 
-	return 0;
+	lua->PushNumber(static_cast<double>(generation));
+	return 1;
 }
 
-int32_t RegionalSupplyLua::RemoveFromDemand(lua_State* pState)
+int32_t RegionalSupplyLua::GetResourceQuantities(lua_State* pState)
 {
 	cRZAutoRefCount<cISCLua> lua = SCLuaUtil::GetISCLuaFromFunctionState(pState);
 
 	int32_t parameterCount = lua->GetTop();
 
-	if (parameterCount == 2)
+	if (parameterCount == 1 && lua->Type(1) == cIGZLua5Thread::LuaTypeTable)
 	{
-		uint32_t amount = 0;
-		uint32_t resourceID = 0;
+		// The result table uses the same indices as the resource id table,
+		// the quantity of an invalid resource id is 0.
+		lua->NewTable();
 
-		// Function parameters are popped off the stack in right-to-left order.
-
-		if (TryGetNumberAsUint32(lua, -1, amount)
-			&& TryGetNumberAsUint32(lua, -2, resourceID))
+		for (int32_t i = 1; ; i++)
 		{
-			spRegionalSupplyManager->RemoveFromDemand(resourceID, amount);
+			lua->RawGetI(1, i);
+
+			if (lua->Type(-1) == cIGZLua5Thread::LuaTypeNil)
+			{
+				lua->SetTop(-2);
+				break;
+			}
+
+			int64_t quantity = 0;
+			uint32_t resourceID = 0;
+
+			if (LuaBinding::TryGetNumber(lua, -1, resourceID))
+			{
+				quantity = spRegionalSupplyManager->GetResourceQuantity(resourceID);
+			}
+
+			lua->SetTop(-2);
+			lua->PushNumber(static_cast<double>(quantity));
+			lua->RawSetI(-2, i);
 		}
 	}
+	else
+	{
+		lua->PushNil();
+	}
 
-	return 0;
+	return 1;
 }
 
-int32_t RegionalSupplyLua::AddToSupply(lua_State* pState)
+int32_t RegionalSupplyLua::ApplyDeltas(lua_State* pState)
 {
 	cRZAutoRefCount<cISCLua> lua = SCLuaUtil::GetISCLuaFromFunctionState(pState);
 
 	int32_t parameterCount = lua->GetTop();
 
-	if (parameterCount == 2)
+	if (parameterCount == 1 && lua->Type(1) == cIGZLua5Thread::LuaTypeTable)
 	{
-		uint32_t amount = 0;
-		uint32_t resourceID = 0;
+		std::array<ResourceDelta, MaxStackResourceDeltas> stackDeltas;
+		std::vector<ResourceDelta> heapDeltas;
+		size_t count = 0;
+		bool valid = true;
 
-		// Function parameters are popped off the stack in right-to-left order.
+		for (int32_t i = 1; valid; i++)
+		{
+			lua->RawGetI(1, i);
+
+			if (lua->Type(-1) == cIGZLua5Thread::LuaTypeNil)
+			{
+				lua->SetTop(-2);
+				break;
+			}
+
+			ResourceDelta delta{};
+
+			valid = TryGetResourceDelta(lua, delta);
+
+			if (valid)
+			{
+				if (count < stackDeltas.size())
+				{
+					stackDeltas[count] = delta;
+				}
+				else
+				{
+					if (count == stackDeltas.size())
+					{
+						heapDeltas.reserve(count * 2);
+						heapDeltas.assign(stackDeltas.begin(), stackDeltas.end());
+					}
+
+					heapDeltas.push_back(delta);
+				}
+
+				count++;
+			}
+
+			lua->SetTop(-2);
+		}
 
-		if (TryGetNumberAsUint32(lua, -1, amount)
-			&& TryGetNumberAsUint32(lua, -2, resourceID))
+		// The deltas are only applied if every entry is valid, this prevents a
+		// malformed table from leaving the resources partially updated.
+		if (valid && count > 0)
 		{
-			spRegionalSupplyManager->AddToSupply(resourceID, amount);
+			const ResourceDelta* pDeltas = count > stackDeltas.size() ? heapDeltas.data() : stackDeltas.data();
+
+			spRegionalSupplyManager->ApplyDeltas(pDeltas, count);
 		}
 	}
 
 	return 0;
 }
 
-int32_t RegionalSupplyLua::RemoveFromSupply(lua_State* pState)
+int32_t RegionalSupplyLua::Watch(lua_State* pState)
 {
 	cRZAutoRefCount<cISCLua> lua = SCLuaUtil::GetISCLuaFromFunctionState(pState);
 
 	int32_t parameterCount = lua->GetTop();
 
-	if (parameterCount == 2)
+	if (parameterCount == 4 && lua->Type(-1) == cIGZLua5Thread::LuaTypeString)
 	{
-		uint32_t amount = 0;
 		uint32_t resourceID = 0;
+		int64_t low = 0;
+		int64_t high = 0;
 
 		// Function parameters are popped off the stack in right-to-left order.
 
-		if (TryGetNumberAsUint32(lua, -1, amount)
-			&& TryGetNumberAsUint32(lua, -2, resourceID))
+		if (LuaBinding::TryGetNumber(lua, -2, high)
+			&& LuaBinding::TryGetNumber(lua, -3, low)
+			&& LuaBinding::TryGetNumber(lua, -4, resourceID)
+			&& low <= high)
 		{
-			spRegionalSupplyManager->RemoveFromSupply(resourceID, amount);
+			const char* callbackName = lua->ToString(-1);
+
+			if (callbackName && callbackName[0] != '\0')
+			{
+				spResourceWatchList->Add(resourceID, low, high, callbackName);
+			}
 		}
 	}
 
 	return 0;
 }
 
-int32_t RegionalSupplyLua::GetResourceQuantity(lua_State* pState)
+void RegionalSupplyLua::DispatchWatchEvents(cISCLua* pLua, std::span<const ResourceWatchList::Event> events)
 {
-	cRZAutoRefCount<cISCLua> lua = SCLuaUtil::GetISCLuaFromFunctionState(pState);
-
-	int64_t quantity = 0;
+	PROFILE_SCOPE(LuaDispatchWatchEvents);
 
-	int32_t parameterCount = lua->GetTop();
+	const int32_t top = pLua->GetTop();
 
-	if (parameterCount == 1)
+	for (const ResourceWatchList::Event& event : events)
 	{
-		uint32_t resourceID = 0;
+		pLua->GetGlobal(event.callbackName.c_str());
 
-		if (TryGetNumberAsUint32(lua, -1, resourceID))
+		if (pLua->IsFunction(-1))
 		{
-			quantity = spRegionalSupplyManager->GetResourceQuantity(resourceID);
+			pLua->PushNumber(static_cast<double>(event.resourceID));
+			pLua->PushNumber(static_cast<double>(event.quantity));
+
+			if (pLua->PCall(2, 0, 0) != 0)
+			{
+				const char* message = pLua->ToString(-1);
+
+				LOG_ERROR(
+					"The %s watch callback failed: %s",
+					event.callbackName.c_str(),
+					message ? message : "unknown error");
+			}
+		}
+		else
+		{
+			LOG_ERROR("The %s watch callback is not a global Lua function.", event.callbackName.c_str());
 		}
-	}
 
-	lua->PushNumber(static_cast<double>(quantity));
-	return 1;
+		pLua->SetTop(top);
+	}
 }
@@ -21,14 +21,37 @@
 
 #pragma once
 #include "cISCLua.h"
+#include "ResourceWatchList.h"
+#include <span>
 
 namespace RegionalSupplyLua
 {
-	int32_t AddToDemand(lua_State* pState);
-	int32_t RemoveFromDemand(lua_State* pState);
+	struct Function
+	{
+		const char* name;
+		lua_CFunction callback;
+	};
 
-	int32_t AddToSupply(lua_State* pState);
-	int32_t RemoveFromSupply(lua_State* pState);
+	// Gets the functions of the regional_supply table.
+	// The functions that take fixed numeric arguments are thunks generated by
+	// LuaBinding::MethodThunk, the functions below handle tables, strings or
+	// optional arguments.
+	std::span<const Function> GetFunctions();
 
-	int32_t GetResourceQuantity(lua_State* pState);
+	// Returns the region generation, or the resource generation if a resource id is provided.
+	int32_t GetGeneration(lua_State* pState);
+
+	// Takes an array of resource ids and returns an array of their quantities.
+	int32_t GetResourceQuantities(lua_State* pState);
+	// Takes an array of { resourceID, amount } pairs and applies them as a single batch.
+	// A positive amount adds to the supply and a negative amount adds to the demand.
+	int32_t ApplyDeltas(lua_State* pState);
+
+	// Takes a resource id, a low and high threshold and the name of a global Lua function.
+	// The function is called with the resource id and quantity when the quantity crosses
+	// either threshold.
+	int32_t Watch(lua_State* pState);
+
+	// Calls the Lua callback function of each watch event.
+	void DispatchWatchEvents(cISCLua* pLua, std::span<const ResourceWatchList::Event> events);
 }
\ No newline at end of file
@@ -20,183 +20,1350 @@
  */
 
 #include "RegionalSupplyManager.h"
+#include "ByteSpanReader.h"
 #include "cGZPersistResourceKey.h"
 #include "cIGZDBSegmentPackedFile.h"
 #include "cIGZPersistDBRecord.h"
 #include "cIGZPersistDBSegment.h"
 #include "cIGZPersistDBSerialRecord.h"
 #include "cRZAutoRefCount.h"
+#include "Crc32C.h"
+#include "DBPFIndexReader.h"
 #include "Logger.h"
+#include "MemoryMappedFile.h"
+#include "Profiler.h"
+#include "ResourceDeltaUtil.h"
+#include "ResourceTableCodec.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <vector>
 
 static const cGZPersistResourceKey key(0xA82A8BEC, 0x655AEDB3, 1);
+static const cGZPersistResourceKey cityLedgersKey(0xA82A8BEC, 0x655AEDB3, 2);
+
+namespace
+{
+	// Most buildings only have a few resource entries, so the deltas are
+	// merged in a stack buffer unless the caller passes a large set.
+	constexpr size_t MaxStackResourceDeltas = 64;
+
+	// The journal is compacted into a new snapshot when it reaches 1 MiB.
+	constexpr size_t JournalCompactionThreshold = 65536;
+
+	// Guards against allocating a huge buffer for a corrupted record.
+	constexpr uint32_t MaxEncodedResourceDataSize = 64 * 1024 * 1024;
+
+	// The memory budget for the state of the regions that are not currently loaded.
+	constexpr size_t RegionStateCacheMemoryBudget = 32 * 1024 * 1024;
+
+	// Version 2 and earlier of the city ledgers record keyed the ledgers by the city name.
+	// Those ledgers are kept under a prefix that cannot appear in a file name until the city
+	// is next loaded, at which point the ledger is moved to the city's save file name.
+	constexpr std::string_view LegacyCityKeyPrefix = "|";
+
+	std::string MakeLegacyCityKey(std::string_view cityName)
+	{
+		std::string cityKey(LegacyCityKeyPrefix);
+		cityKey.append(cityName);
+
+		return cityKey;
+	}
+
+	std::filesystem::path GetJournalPath(const std::filesystem::path& dataFilePath)
+	{
+		std::filesystem::path journalPath = dataFilePath;
+		journalPath.replace_extension(".journal");
+
+		return journalPath;
+	}
+
+	// Reads the specified record if it exists.
+	// Returns false if the record exists and the reader failed.
+	template <typename TReader>
+	bool ReadSerialRecord(cIGZPersistDBSegment* pSegment, const cGZPersistResourceKey& recordKey, TReader&& reader)
+	{
+		bool result = true;
+
+		cRZAutoRefCount<cIGZPersistDBRecord> record;
+
+		if (pSegment->OpenRecord(recordKey, record.AsPPObj(), cIGZFile::AccessMode::Read))
+		{
+			cRZAutoRefCount<cIGZPersistDBSerialRecord> serialRecord;
+
+			if (record->QueryInterface(
+				GZIID_cIGZPersistDBSerialRecord,
+				serialRecord.AsPPVoid()))
+			{
+				result = reader(*serialRecord);
+
+				pSegment->CloseRecord(serialRecord->AsIGZPersistDBRecord());
+			}
+		}
+
+		return result;
+	}
+
+	// Writes the specified record, the record is discarded if the writer fails.
+	template <typename TWriter>
+	bool WriteSerialRecord(cIGZPersistDBSegment* pSegment, const cGZPersistResourceKey& recordKey, TWriter&& writer)
+	{
+		bool result = false;
+
+		cRZAutoRefCount<cIGZPersistDBRecord> record;
+
+		if (pSegment->OpenRecord(recordKey, record.AsPPObj(), cIGZFile::AccessMode::ReadWrite))
+		{
+			cRZAutoRefCount<cIGZPersistDBSerialRecord> serialRecord;
+
+			if (record->QueryInterface(
+				GZIID_cIGZPersistDBSerialRecord,
+				serialRecord.AsPPVoid()))
+			{
+				if (writer(*serialRecord))
+				{
+					pSegment->CloseRecord(serialRecord->AsIGZPersistDBRecord());
+					result = true;
+				}
+				else
+				{
+					pSegment->AbortRecord(serialRecord->AsIGZPersistDBRecord());
+				}
+			}
+		}
+
+		return result;
+	}
+
+	template <typename TRecord>
+	bool ReadResourceTable(TRecord& record, ResourceTable& table)
+	{
+		uint32_t itemCount = 0;
+
+		if (!record.GetFieldUint32(itemCount))
+		{
+			return false;
+		}
+
+		for (uint32_t i = 0; i < itemCount; i++)
+		{
+			uint32_t resourceID = 0;
+
+			if (!record.GetFieldUint32(resourceID))
+			{
+				return false;
+			}
+
+			int64_t resourceQuantity = 0;
+
+			if (!record.GetFieldSint64(resourceQuantity))
+			{
+				return false;
+			}
+
+			table.Set(resourceID, resourceQuantity);
+		}
+
+		return true;
+	}
+
+	bool ReadEncodedData(
+		cIGZPersistDBSerialRecord& record,
+		uint32_t size,
+		std::vector<uint8_t>& storage,
+		std::span<const uint8_t>& data)
+	{
+		storage.resize(size);
+
+		if (size > 0 && !record.GetFieldVoid(storage.data(), size))
+		{
+			return false;
+		}
+
+		data = storage;
+		return true;
+	}
+
+	bool ReadEncodedData(
+		ByteSpanReader& record,
+		uint32_t size,
+		std::vector<uint8_t>& /*storage*/,
+		std::span<const uint8_t>& data)
+	{
+		// The data is decoded directly from the mapped file.
+		return record.GetFieldSpan(size, data);
+	}
+
+	// The encoded data ends with a CRC of the preceding bytes, so it is excluded from the
+	// checksum. The CRC of data that includes its own CRC is the same for every input.
+	uint32_t UpdateEncodedDataChecksum(const std::vector<uint8_t>& encodedData, uint32_t checksum)
+	{
+		return Crc32C::Compute(encodedData.data(), encodedData.size() - sizeof(uint32_t), checksum);
+	}
+
+	bool WriteResourceTable(cIGZPersistDBSerialRecord& record, const ResourceTable& table)
+	{
+		if (!record.SetFieldUint32(static_cast<uint32_t>(table.GetCount())))
+		{
+			return false;
+		}
+
+		return table.ForEach([&](uint32_t resourceID, int64_t resourceQuantity)
+		{
+			return record.SetFieldUint32(resourceID) && record.SetFieldSint64(resourceQuantity);
+		});
+	}
+}
+
+RegionalSupplyManager::SaveSnapshot::SaveSnapshot(cIGZPersistDBSegment* pSegment)
+	: segment(pSegment),
+	  resources(),
+	  cityLedgers(),
+	  activeCityName(),
+	  hasActiveCity(false),
+	  generation(0),
+	  sequence(0),
+	  journalEntryCount(0)
+{
+}
+
+RegionalSupplyManager::RegionalSupplyManager()
+	: cRZBaseSystemService(kRegionalSupplyManagerServiceID, 0),
+	  resources(),
+	  cityLedgers(),
+	  pActiveCity(nullptr),
+	  snapshotLedgers(),
+	  journal(),
+	  regionStateCache(RegionStateCacheMemoryBudget),
+	  watchList(),
+	  watchEventHandler(),
+	  watchEvents(),
+	  journalCompactionHandler(),
+	  loadedDataFilePath(),
+	  updateMutex(),
+	  loadMutex(),
+	  pendingLoad(),
+	  loadPending(false),
+	  pendingSave(),
+	  snapshotSequence(0),
+	  generation(0),
+	  resourceGenerations(),
+	  resourceGenerationBase(0),
+	  lastPersistedGeneration(0),
+	  lastPersistedChecksum(0),
+	  persistedSnapshotCommitted(false)
+{
+	Clear();
+}
+
+RegionalSupplyManager::~RegionalSupplyManager()
+{
+	WaitForPendingLoad();
+	WaitForPendingSave();
+}
+
+void RegionalSupplyManager::LoadAsync(cIGZPersistDBSegment* pSegment, const std::filesystem::path& dataFilePath)
+{
+	WaitForPendingLoad();
+	WaitForPendingSave();
+
+	CacheLoadedRegion();
+	loadedDataFilePath = dataFilePath;
+
+	// Switching back to a recently visited region skips the disk read.
+	if (dataFilePath.empty() || !RestoreCachedRegion(dataFilePath))
+	{
+		cRZAutoRefCount<cIGZPersistDBSegment> segment(pSegment);
+
+		std::scoped_lock lock(loadMutex);
+
+		// The flag is set first so that the callers on other threads
+		// do not read the previous region's data.
+		loadPending.store(true, std::memory_order_release);
+		pendingLoad = std::async(
+			std::launch::async,
+			[this, segment, dataFilePath]()
+			{
+				LoadRegion(segment, dataFilePath);
+			});
+	}
+}
+
+void RegionalSupplyManager::Clear()
+{
+	WaitForPendingSave();
+
+	resources.Clear();
+	cityLedgers.clear();
+	pActiveCity = nullptr;
+	snapshotLedgers.clear();
+	snapshotSequence = 0;
+	ResetResourceGenerations();
+
+	// An empty region does not need to be saved until it changes.
+	std::vector<uint8_t> resourceData;
+	const uint64_t currentGeneration = EncodeResources(resourceData);
+	MarkPersisted(currentGeneration, ComputeSnapshotChecksum(resourceData, cityLedgers));
+}
 
 void RegionalSupplyManager::Load(cIGZPersistDBSegment* pSegment)
 {
-	resources.clear();
+	LoadRecords([&](const cGZPersistResourceKey& recordKey, auto&& reader)
+	{
+		return ReadSerialRecord(pSegment, recordKey, reader);
+	});
+}
+
+bool RegionalSupplyManager::LoadMappedFile(const std::filesystem::path& dataFilePath)
+{
+	MemoryMappedFile file;
+
+	if (!file.Open(dataFilePath))
+	{
+		return false;
+	}
+
+	DBPFIndexReader index;
+
+	// Compressed records are left to the packed file segment.
+	if (!index.Open(file.GetData())
+		|| index.IsCompressed(key.type, key.group, key.instance)
+		|| index.IsCompressed(cityLedgersKey.type, cityLedgersKey.group, cityLedgersKey.instance))
+	{
+		return false;
+	}
+
+	LoadRecords([&](const cGZPersistResourceKey& recordKey, auto&& reader)
+	{
+		std::span<const uint8_t> recordData;
+
+		// A missing record is not an error, this matches ReadSerialRecord.
+		if (!index.FindRecord(recordKey.type, recordKey.group, recordKey.instance, recordData))
+		{
+			return true;
+		}
+
+		ByteSpanReader record(recordData);
+
+		return reader(record);
+	});
+
+	return true;
+}
+
+template <typename TReadRecord>
+void RegionalSupplyManager::LoadRecords(TReadRecord&& readRecord)
+{
+	Clear();
+
+	const bool loaded = readRecord(
+		key,
+		[this](auto& record) { return LoadFromSerialRecord(record); });
+
+	if (loaded)
+	{
+		// The city ledgers are optional, older versions of the plugin did not write them.
+		const bool ledgersLoaded = readRecord(
+			cityLedgersKey,
+			[this](auto& record) { return LoadCityLedgersFromSerialRecord(record); });
+
+		if (!ledgersLoaded)
+		{
+			LOG_ERROR(
+				"Failed to load the city resource ledgers.");
+			cityLedgers.clear();
+			snapshotSequence = 0;
+		}
+	}
+	else
+	{
+		LOG_ERROR(
+			"Failed to load the region resource data.");
+		resources.Clear();
+	}
+
+	std::vector<uint8_t> resourceData;
+	const uint64_t currentGeneration = EncodeResources(resourceData);
+	MarkPersisted(currentGeneration, ComputeSnapshotChecksum(resourceData, cityLedgers));
+}
+
+void RegionalSupplyManager::SaveAsync(cIGZPersistDBSegment* pSegment, SaveCompletionCallback callback)
+{
+	PROFILE_SCOPE(ManagerSaveSnapshot);
+
+	const auto snapshotStart = std::chrono::steady_clock::now();
+
+	EnsureLoaded();
+	WaitForPendingSave();
+
+	auto snapshot = std::make_unique<SaveSnapshot>(pSegment);
+	snapshot->sequence = snapshotSequence + 1;
+
+	{
+		// Blocks the resource updates so that the snapshot and the journal position match.
+		std::unique_lock lock(updateMutex);
+
+		snapshot->generation = generation.load();
+		resources.CopyTo(snapshot->resources);
+		// Only the ledger pointers are copied, a ledger is copied when it is next modified.
+		snapshot->cityLedgers = cityLedgers;
+		snapshotLedgers.clear();
+
+		for (const auto& city : cityLedgers)
+		{
+			snapshotLedgers.insert(city.second.get());
+		}
+		snapshot->hasActiveCity = pActiveCity != nullptr;
+		snapshot->activeCityName = pActiveCity ? pActiveCity->first : std::string();
+		snapshot->journalEntryCount = journal.GetEntryCount();
+	}
+
+	const std::chrono::duration<double, std::milli> snapshotTime = std::chrono::steady_clock::now() - snapshotStart;
+
+	pendingSave = std::async(
+		std::launch::async,
+		[this, snapshot = std::move(snapshot), callback = std::move(callback), snapshotTime]()
+		{
+			const auto writeStart = std::chrono::steady_clock::now();
+
+			SaveResult result{};
+			result.snapshotMilliseconds = snapshotTime.count();
+
+			WriteSnapshot(*snapshot, result);
+
+			const std::chrono::duration<double, std::milli> writeTime = std::chrono::steady_clock::now() - writeStart;
+			result.writeMilliseconds = writeTime.count();
+
+			if (callback)
+			{
+				callback(result);
+			}
+		});
+}
+
+void RegionalSupplyManager::WaitForPendingSave()
+{
+	if (pendingSave.valid())
+	{
+		pendingSave.get();
+	}
+}
+
+bool RegionalSupplyManager::CheckForUnsavedChanges()
+{
+	EnsureLoaded();
+
+	if (IsSavePending())
+	{
+		// The save sets the persisted generation when it finishes, the next
+		// save checks the data again.
+		return true;
+	}
+
+	return generation.load() != lastPersistedGeneration;
+}
+
+void RegionalSupplyManager::OpenJournal(const std::filesystem::path& path)
+{
+	std::vector<RegionalSupplyJournal::ReplayEntry> replayEntries;
+	bool hasLegacyCityNames = false;
+
+	if (journal.Open(path, snapshotSequence, replayEntries, hasLegacyCityNames))
+	{
+		if (hasLegacyCityNames)
+		{
+			// The journal was written by an older version of the plugin, so the city
+			// names refer to the ledgers that were loaded with the legacy keys.
+			for (auto& entry : replayEntries)
+			{
+				if (entry.type == RegionalSupplyJournal::EntryType::CityBegin)
+				{
+					entry.cityName = MakeLegacyCityKey(entry.cityName);
+				}
+			}
+
+			journal.Rewrite(snapshotSequence, replayEntries);
+		}
+
+		CityLedgerMap::value_type* pReplayCity = nullptr;
+
+		for (const auto& entry : replayEntries)
+		{
+			switch (entry.type)
+			{
+			case RegionalSupplyJournal::EntryType::CityBegin:
+				pReplayCity = &GetOrAddCityLedger(entry.cityName);
+				break;
+			case RegionalSupplyJournal::EntryType::CityRename:
+				pReplayCity = pReplayCity
+					? &RenameCityLedger(*pReplayCity, entry.cityName)
+					: &GetOrAddCityLedger(entry.cityName);
+				break;
+			case RegionalSupplyJournal::EntryType::BuildingDelta:
+				resources.Add(entry.delta.resourceID, entry.delta.amount);
+
+				if (pReplayCity)
+				{
+					GetWritableLedger(pReplayCity->second).Add(entry.delta.resourceID, entry.delta.amount);
+				}
+				break;
+			case RegionalSupplyJournal::EntryType::RegionDelta:
+				resources.Add(entry.delta.resourceID, entry.delta.amount);
+				break;
+			}
+		}
+
+		if (!replayEntries.empty())
+		{
+			generation.fetch_add(1);
+
+			LOG_INFO(
+				"Replayed %u region resource journal entries.",
+				static_cast<uint32_t>(replayEntries.size()));
+		}
+	}
+}
+
+void RegionalSupplyManager::CloseJournal()
+{
+	EnsureLoaded();
+	journal.Close();
+}
+
+void RegionalSupplyManager::FlushJournal()
+{
+	EnsureLoaded();
+	journal.Flush();
+}
+
+bool RegionalSupplyManager::IsJournalCompactionNeeded() const
+{
+	EnsureLoaded();
+
+	// The pending save will shrink the journal when it finishes.
+	return journal.GetEntryCount() >= JournalCompactionThreshold && !IsSavePending();
+}
+
+void RegionalSupplyManager::BeginCitySession(
+	std::string_view cityID,
+	std::string_view cityName,
+	std::span<const ResourceDelta> buildingTotals)
+{
+	PROFILE_SCOPE(ManagerBeginCitySession);
+
+	EnsureLoaded();
+
+	if (!cityID.empty())
+	{
+		// The game discarded the last unsaved city, e.g. because it crashed.
+		DiscardUnsavedCity();
+
+		if (cityLedgers.find(cityID) == cityLedgers.end())
+		{
+			auto legacyCity = cityLedgers.find(MakeLegacyCityKey(cityName));
+
+			if (legacyCity != cityLedgers.end())
+			{
+				// Older versions of the plugin shared one ledger between the cities with the
+				// same name, the first of those cities to be loaded takes the ledger over.
+				journal.AppendCityBegin(legacyCity->first);
+				journal.AppendCityRename(cityID);
+				RenameCityLedger(*legacyCity, cityID);
+			}
+		}
+	}
+
+	CityLedgerMap::value_type& city = GetOrAddCityLedger(cityID);
+	ResourceTable& ledger = GetWritableLedger(city.second);
+
+	// The building totals are sorted by resource id, so the ledger entries that
+	// are missing from the totals can be found with a binary search.
+	std::vector<ResourceDelta> totals(buildingTotals.begin(), buildingTotals.end());
+	totals.resize(ResourceDeltaUtil::SortAndMerge(totals.data(), totals.size()));
+
+	std::vector<ResourceDelta> changes;
+	changes.reserve(totals.size());
+
+	for (const ResourceDelta& total : totals)
+	{
+		const int64_t change = total.amount - ledger.Get(total.resourceID);
+
+		// Reloading an unchanged city leaves the data in its saved state.
+		if (change != 0)
+		{
+			changes.emplace_back(total.resourceID, change);
+		}
+	}
+
+	ledger.ForEach([&](uint32_t resourceID, int64_t quantity)
+	{
+		const bool inTotals = std::ranges::binary_search(
+			totals,
+			resourceID,
+			{},
+			&ResourceDelta::resourceID);
+
+		if (!inTotals && quantity != 0)
+		{
+			changes.emplace_back(resourceID, -quantity);
+		}
+
+		return true;
+	});
+
+	// Applying the changes to the ledger leaves it equal to the building totals.
+	journal.AppendCityBegin(cityID);
+	ApplyDeltasCore(changes.data(), changes.size(), &ledger);
+
+	pActiveCity = &city;
+}
+
+void RegionalSupplyManager::AssignActiveCityID(std::string_view cityID)
+{
+	EnsureLoaded();
+
+	if (!pActiveCity || !pActiveCity->first.empty() || cityID.empty())
+	{
+		return;
+	}
+
+	auto existingCity = cityLedgers.find(cityID);
+
+	if (existingCity != cityLedgers.end())
+	{
+		// The ledger belongs to a city that was deleted from the region, the new
+		// city reused its save file name.
+		RemoveCityContributions(*existingCity);
+		journal.AppendCityBegin(pActiveCity->first);
+	}
+
+	journal.AppendCityRename(cityID);
+	pActiveCity = &RenameCityLedger(*pActiveCity, cityID);
+}
+
+void RegionalSupplyManager::EndCitySession()
+{
+	EnsureLoaded();
+
+	if (pActiveCity && pActiveCity->first.empty())
+	{
+		DiscardUnsavedCity();
+	}
+
+	pActiveCity = nullptr;
+}
+
+void RegionalSupplyManager::ApplyBuildingDeltas(std::span<const ResourceDelta> deltas)
+{
+	EnsureLoaded();
+
+	ApplyDeltasCore(
+		deltas.data(),
+		deltas.size(),
+		pActiveCity ? &GetWritableLedger(pActiveCity->second) : nullptr);
+}
+
+ResourceWatchList& RegionalSupplyManager::GetWatchList()
+{
+	return watchList;
+}
+
+void RegionalSupplyManager::SetWatchEventHandler(WatchEventHandler handler)
+{
+	watchEventHandler = std::move(handler);
+}
+
+void RegionalSupplyManager::SetJournalCompactionHandler(JournalCompactionHandler handler)
+{
+	journalCompactionHandler = std::move(handler);
+}
+
+bool RegionalSupplyManager::OnTick(uint32_t /*unknown*/)
+{
+	watchList.TakePendingEvents(watchEvents);
+
+	if (!watchEvents.empty())
+	{
+		if (watchEventHandler)
+		{
+			watchEventHandler(watchEvents);
+		}
+
+		watchEvents.clear();
+	}
+
+	// The journal is checked once per tick instead of after every building change,
+	// a tick can apply thousands of changes while a city is being built or bulldozed.
+	// The check is skipped while the region is loading so that the tick does not wait for it.
+	if (journalCompactionHandler
+		&& !loadPending.load(std::memory_order_acquire)
+		&& IsJournalCompactionNeeded())
+	{
+		journalCompactionHandler();
+	}
+
+	return true;
+}
+
+bool RegionalSupplyManager::QueryInterface(uint32_t riid, void** ppvObj)
+{
+	if (riid == GZIID_IRegionalSupplyManager)
+	{
+		*ppvObj = static_cast<IRegionalSupplyManager*>(this);
+		AddRef();
+
+		return true;
+	}
+	else if (riid == GZIID_IRegionalSupplyManager2)
+	{
+		*ppvObj = static_cast<IRegionalSupplyManager2*>(this);
+		AddRef();
+
+		return true;
+	}
+
+	return cRZBaseSystemService::QueryInterface(riid, ppvObj);
+}
+
+uint32_t RegionalSupplyManager::AddRef()
+{
+	return cRZBaseSystemService::AddRef();
+}
+
+uint32_t RegionalSupplyManager::Release()
+{
+	return cRZBaseSystemService::Release();
+}
+
+void RegionalSupplyManager::AddToDemand(uint32_t resourceID, uint32_t amount)
+{
+	RemoveFromSupply(resourceID, amount);
+}
+
+void RegionalSupplyManager::RemoveFromDemand(uint32_t resourceID, uint32_t amount)
+{
+	AddToSupply(resourceID, amount);
+}
+
+void RegionalSupplyManager::AddToSupply(uint32_t resourceID, uint32_t amount)
+{
+	const ResourceDelta delta{ resourceID, static_cast<int64_t>(amount) };
+
+	ApplyDeltasCore(&delta, 1, nullptr);
+}
+
+void RegionalSupplyManager::RemoveFromSupply(uint32_t resourceID, uint32_t amount)
+{
+	const ResourceDelta delta{ resourceID, -static_cast<int64_t>(amount) };
+
+	ApplyDeltasCore(&delta, 1, nullptr);
+}
+
+int64_t RegionalSupplyManager::GetResourceQuantity(uint32_t resourceID) const
+{
+	EnsureLoaded();
+
+	return resources.Get(resourceID);
+}
+
+void RegionalSupplyManager::ApplyDeltas(const ResourceDelta* pDeltas, size_t count)
+{
+	ApplyDeltasCore(pDeltas, count, nullptr);
+}
+
+uint64_t RegionalSupplyManager::GetGeneration() const
+{
+	EnsureLoaded();
 
-	cRZAutoRefCount<cIGZPersistDBRecord> record;
+	return generation.load();
+}
+
+uint64_t RegionalSupplyManager::GetResourceGeneration(uint32_t resourceID) const
+{
+	EnsureLoaded();
+
+	const uint64_t resourceGeneration = static_cast<uint64_t>(resourceGenerations.Get(resourceID));
+
+	return std::max(resourceGeneration, resourceGenerationBase.load());
+}
+
+void RegionalSupplyManager::ApplyDeltasCore(const ResourceDelta* pDeltas, size_t count, ResourceTable* pCityLedger)
+{
+	PROFILE_SCOPE(ManagerApplyDeltas);
+
+	EnsureLoaded();
+
+	if (!pDeltas || count == 0)
+	{
+		return;
+	}
+
+	const ResourceDelta* pMerged = pDeltas;
+	size_t mergedCount = count;
+
+	std::array<ResourceDelta, MaxStackResourceDeltas> stackBuffer;
+	std::vector<ResourceDelta> heapBuffer;
+
+	if (!ResourceDeltaUtil::IsSortedAndUnique(pDeltas, count))
+	{
+		ResourceDelta* pBuffer = stackBuffer.data();
 
-	if (pSegment->OpenRecord(key, record.AsPPObj(), cIGZFile::AccessMode::Read))
+		if (count > stackBuffer.size())
+		{
+			heapBuffer.resize(count);
+			pBuffer = heapBuffer.data();
+		}
+
+		std::copy_n(pDeltas, count, pBuffer);
+
+		mergedCount = ResourceDeltaUtil::SortAndMerge(pBuffer, count);
+		pMerged = pBuffer;
+	}
+
+	ResourceWatchList::QuantityChange* pChanges = nullptr;
+
+	std::array<ResourceWatchList::QuantityChange, MaxStackResourceDeltas> stackChanges;
+	std::vector<ResourceWatchList::QuantityChange> heapChanges;
+
+	if (watchList.HasWatches())
 	{
-		cRZAutoRefCount<cIGZPersistDBSerialRecord> serialRecord;
+		pChanges = stackChanges.data();
+
+		if (mergedCount > stackChanges.size())
+		{
+			heapChanges.resize(mergedCount);
+			pChanges = heapChanges.data();
+		}
+	}
+
+	{
+		std::shared_lock lock(updateMutex);
+
+		for (size_t i = 0; i < mergedCount; i++)
+		{
+			const int64_t newQuantity = resources.Add(pMerged[i].resourceID, pMerged[i].amount);
 
-		if (record->QueryInterface(
-			GZIID_cIGZPersistDBSerialRecord,
-			serialRecord.AsPPVoid()))
+			if (pChanges)
+			{
+				pChanges[i] = { pMerged[i].resourceID, newQuantity - pMerged[i].amount, newQuantity };
+			}
+		}
+
+		if (pCityLedger)
 		{
-			if (!LoadFromSerialRecord(*serialRecord))
+			for (size_t i = 0; i < mergedCount; i++)
 			{
-				Logger::GetInstance().WriteLine(
-					LogLevel::Error,
-					"Failed to load the region resource data.");
-				resources.clear();
+				pCityLedger->Add(pMerged[i].resourceID, pMerged[i].amount);
 			}
+		}
+
+		journal.AppendDeltas(
+			pCityLedger ? RegionalSupplyJournal::EntryType::BuildingDelta : RegionalSupplyJournal::EntryType::RegionDelta,
+			pMerged,
+			mergedCount);
 
-			pSegment->CloseRecord(serialRecord->AsIGZPersistDBRecord());
+		// The generations are updated after the quantities, so a reader that sees
+		// the new generation also sees the new quantities.
+		// Callers share the update lock, so a caller that took an older generation can
+		// reach this point last. StoreMax keeps it from moving a resource generation back.
+		const uint64_t newGeneration = generation.fetch_add(1) + 1;
+
+		for (size_t i = 0; i < mergedCount; i++)
+		{
+			resourceGenerations.StoreMax(pMerged[i].resourceID, static_cast<int64_t>(newGeneration));
 		}
 	}
+
+	// The watches take their own lock, so they are checked after the update lock is
+	// released to keep a save snapshot from waiting for them.
+	if (pChanges)
+	{
+		watchList.OnQuantitiesChanged(pChanges, mergedCount);
+	}
+}
+
+void RegionalSupplyManager::ResetResourceGenerations()
+{
+	resourceGenerations.Clear();
+	resourceGenerationBase.store(generation.fetch_add(1) + 1);
 }
 
-void RegionalSupplyManager::Save(cIGZPersistDBSegment* pSegment) const
+void RegionalSupplyManager::LoadRegion(cIGZPersistDBSegment* pSegment, const std::filesystem::path& dataFilePath)
 {
-	if (!resources.empty())
+	PROFILE_SCOPE(ManagerLoadRegion);
+
+	const auto loadStart = std::chrono::steady_clock::now();
+	const char* loadMethod = "the memory-mapped file";
+
+	// The callers wait for the load to finish, so they cannot see the new
+	// generations before the new region totals.
+	ResetResourceGenerations();
+
+	// The memory-mapped reader avoids the per-field virtual calls of the
+	// packed file segment, the segment is used when the reader cannot load the file.
+	if (dataFilePath.empty() || !LoadMappedFile(dataFilePath))
 	{
-		cRZAutoRefCount<cIGZPersistDBRecord> record;
+		loadMethod = "the packed file segment";
 
-		if (pSegment->OpenRecord(key, record.AsPPObj(), cIGZFile::AccessMode::ReadWrite))
+		if (pSegment && pSegment->Open(true, false))
 		{
-			cRZAutoRefCount<cIGZPersistDBSerialRecord> serialRecord;
-
-			if (record->QueryInterface(
-				GZIID_cIGZPersistDBSerialRecord,
-				serialRecord.AsPPVoid()))
-			{
-				if (SaveToSerialRecord(*serialRecord))
-				{
-					pSegment->CloseRecord(serialRecord->AsIGZPersistDBRecord());
-				}
-				else
-				{
-					Logger::GetInstance().WriteLine(
-						LogLevel::Error,
-						"Failed to save the region resource data.");
-					pSegment->AbortRecord(serialRecord->AsIGZPersistDBRecord());
-				}
-			}
+			Load(pSegment);
 		}
+		else
+		{
+			Clear();
+		}
+	}
+
+	// The journal contains the changes that were made after the data file was saved.
+	if (dataFilePath.empty())
+	{
+		journal.Close();
+	}
+	else
+	{
+		OpenJournal(GetJournalPath(dataFilePath));
 	}
+
+	const std::chrono::duration<double, std::milli> loadTime = std::chrono::steady_clock::now() - loadStart;
+
+	LOG_INFO(
+		"Loaded the region resource data from %s in %.2f ms.",
+		loadMethod,
+		loadTime.count());
 }
 
-void RegionalSupplyManager::AddToDemand(uint32_t resourceID, uint32_t amount)
+void RegionalSupplyManager::CacheLoadedRegion()
 {
-	RemoveFromSupply(resourceID, amount);
+	if (!loadedDataFilePath.empty())
+	{
+		RegionState state;
+
+		// The journal is closed first so that the cached file stamp includes every entry.
+		state.journalRecordCount = journal.Close();
+		resources.CopyTo(state.resources);
+		state.cityLedgers = std::move(cityLedgers);
+		state.snapshotSequence = snapshotSequence;
+		state.persistedChecksum = lastPersistedChecksum;
+		state.hasUnsavedChanges = generation.load() != lastPersistedGeneration;
+
+		cityLedgers.clear();
+		pActiveCity = nullptr;
+		snapshotLedgers.clear();
+
+		regionStateCache.Insert(loadedDataFilePath, GetJournalPath(loadedDataFilePath), std::move(state));
+	}
 }
 
-void RegionalSupplyManager::RemoveFromDemand(uint32_t resourceID, uint32_t amount)
+bool RegionalSupplyManager::RestoreCachedRegion(const std::filesystem::path& dataFilePath)
 {
-	AddToSupply(resourceID, amount);
+	const std::filesystem::path journalPath = GetJournalPath(dataFilePath);
+
+	RegionState state;
+
+	if (!regionStateCache.TryTake(dataFilePath, journalPath, state))
+	{
+		return false;
+	}
+
+	resources.Assign(state.resources);
+	cityLedgers = std::move(state.cityLedgers);
+	pActiveCity = nullptr;
+	snapshotLedgers.clear();
+	snapshotSequence = state.snapshotSequence;
+	ResetResourceGenerations();
+
+	MarkPersisted(generation.fetch_add(1) + 1, state.persistedChecksum);
+
+	if (state.hasUnsavedChanges)
+	{
+		// The next save check compares the checksums.
+		generation.fetch_add(1);
+	}
+
+	// The cached state already includes the journal entries, so the journal is
+	// reopened at its cached end instead of being read again.
+	if (!journal.OpenForAppend(journalPath, snapshotSequence, state.journalRecordCount))
+	{
+		std::vector<RegionalSupplyJournal::ReplayEntry> replayEntries;
+		bool hasLegacyCityNames = false;
+		journal.Open(journalPath, snapshotSequence, replayEntries, hasLegacyCityNames);
+	}
+
+	return true;
 }
 
-void RegionalSupplyManager::AddToSupply(uint32_t resourceID, uint32_t amount)
+void RegionalSupplyManager::EnsureLoaded() const
+{
+	if (loadPending.load(std::memory_order_acquire))
+	{
+		WaitForPendingLoad();
+	}
+}
+
+void RegionalSupplyManager::WaitForPendingLoad() const
 {
-	auto it = resources.find(resourceID);
+	std::scoped_lock lock(loadMutex);
 
-	if (it != resources.end())
+	if (pendingLoad.valid())
 	{
-		it->second += amount;
+		pendingLoad.get();
 	}
-	else
+
+	loadPending.store(false, std::memory_order_release);
+}
+
+RegionalSupplyManager::CityLedgerMap::value_type& RegionalSupplyManager::GetOrAddCityLedger(std::string_view cityID)
+{
+	auto it = cityLedgers.find(cityID);
+
+	if (it == cityLedgers.end())
 	{
-		resources.emplace(resourceID, static_cast<int64_t>(amount));
+		it = cityLedgers.emplace(std::string(cityID), std::make_shared<ResourceTable>()).first;
 	}
+
+	return *it;
 }
 
-void RegionalSupplyManager::RemoveFromSupply(uint32_t resourceID, uint32_t amount)
+RegionalSupplyManager::CityLedgerMap::value_type& RegionalSupplyManager::RenameCityLedger(
+	CityLedgerMap::value_type& city,
+	std::string_view cityID)
+{
+	std::shared_ptr<ResourceTable> ledger = std::move(city.second);
+
+	if (pActiveCity == &city)
+	{
+		pActiveCity = nullptr;
+	}
+
+	cityLedgers.erase(cityLedgers.find(city.first));
+
+	auto result = cityLedgers.insert_or_assign(std::string(cityID), std::move(ledger));
+
+	// The ledger keys are part of the saved data.
+	generation.fetch_add(1);
+
+	return *result.first;
+}
+
+void RegionalSupplyManager::RemoveCityContributions(CityLedgerMap::value_type& city)
+{
+	ResourceTable& ledger = GetWritableLedger(city.second);
+
+	std::vector<ResourceDelta> changes;
+
+	ledger.ForEach([&](uint32_t resourceID, int64_t quantity)
+	{
+		if (quantity != 0)
+		{
+			changes.emplace_back(resourceID, -quantity);
+		}
+
+		return true;
+	});
+
+	journal.AppendCityBegin(city.first);
+	ApplyDeltasCore(changes.data(), changes.size(), &ledger);
+}
+
+void RegionalSupplyManager::DiscardUnsavedCity()
+{
+	auto it = cityLedgers.find(std::string_view());
+
+	if (it != cityLedgers.end())
+	{
+		RemoveCityContributions(*it);
+
+		if (pActiveCity == &*it)
+		{
+			pActiveCity = nullptr;
+		}
+
+		cityLedgers.erase(it);
+		generation.fetch_add(1);
+	}
+}
+
+ResourceTable& RegionalSupplyManager::GetWritableLedger(std::shared_ptr<ResourceTable>& ledger)
+{
+	// The save worker may still be reading the snapshot's ledger, the ledger is
+	// copied whether or not the save has finished.
+	if (snapshotLedgers.erase(ledger.get()) > 0)
+	{
+		ledger = std::make_shared<ResourceTable>(*ledger);
+	}
+
+	return *ledger;
+}
+
+void RegionalSupplyManager::WriteSnapshot(const SaveSnapshot& snapshot, SaveResult& result)
 {
-	auto it = resources.find(resourceID);
+	PROFILE_SCOPE(ManagerWriteSnapshot);
+
+	std::vector<uint8_t> resourceData;
+	ResourceTableCodec::Encode(snapshot.resources, resourceData);
+
+	const uint32_t checksum = ComputeSnapshotChecksum(resourceData, snapshot.cityLedgers);
+
+	result.succeeded = false;
+	result.unchanged = false;
+
+	// The data can return to its saved state, e.g. when a building is
+	// added and then removed during the same city visit.
+	// The existing snapshot is only reused if it was committed to the data file,
+	// a failed save may have left the file without it.
+	if (persistedSnapshotCommitted && checksum == lastPersistedChecksum)
+	{
+		// The existing snapshot already includes the journal entries that were
+		// written before this snapshot was taken.
+		journal.Rebase(
+			snapshotSequence,
+			snapshot.journalEntryCount,
+			snapshot.hasActiveCity ? &snapshot.activeCityName : nullptr);
+
+		MarkPersisted(snapshot.generation, checksum);
+		result.succeeded = true;
+		result.unchanged = true;
+		return;
+	}
+
+	if (!snapshot.segment->Open(true, true))
+	{
+		LOG_ERROR(
+			"Failed to open the region data file for writing.");
+		return;
+	}
+
+	// The file is rewritten from this point, it only holds a valid snapshot
+	// again once the new records have been committed.
+	persistedSnapshotCommitted = false;
+
+	bool recordsSaved = WriteSerialRecord(
+		snapshot.segment,
+		key,
+		[&](cIGZPersistDBSerialRecord& record) { return SaveToSerialRecord(record, resourceData); });
 
-	if (it != resources.end())
+	if (recordsSaved)
 	{
-		it->second -= amount;
+		recordsSaved = WriteSerialRecord(
+			snapshot.segment,
+			cityLedgersKey,
+			[&](cIGZPersistDBSerialRecord& record) { return SaveCityLedgersToSerialRecord(record, snapshot.cityLedgers, snapshot.sequence); });
+
+		if (!recordsSaved)
+		{
+			LOG_ERROR(
+				"Failed to save the city resource ledgers.");
+		}
 	}
 	else
 	{
-		resources.emplace(resourceID, -static_cast<int64_t>(amount));
+		LOG_ERROR(
+			"Failed to save the region resource data.");
+	}
+
+	// The records are committed to the file when the segment is closed. The journal
+	// keeps its entries until then, so that they can be replayed after a crash.
+	const bool closed = snapshot.segment->Close();
+
+	if (recordsSaved)
+	{
+		if (closed)
+		{
+			// The new snapshot includes every journal entry that was written before it was taken.
+			journal.Rebase(
+				snapshot.sequence,
+				snapshot.journalEntryCount,
+				snapshot.hasActiveCity ? &snapshot.activeCityName : nullptr);
+
+			snapshotSequence = snapshot.sequence;
+			MarkPersisted(snapshot.generation, checksum);
+			result.succeeded = true;
+		}
+		else
+		{
+			LOG_ERROR(
+				"Failed to close the region data file, the journal was kept.");
+		}
 	}
 }
 
-int64_t RegionalSupplyManager::GetResourceQuantity(uint32_t resourceID) const
+bool RegionalSupplyManager::IsSavePending() const
+{
+	return pendingSave.valid()
+		&& pendingSave.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+}
+
+template <typename TRecord>
+bool RegionalSupplyManager::LoadFromSerialRecord(TRecord& record)
 {
-	int64_t supply = 0;
+	uint32_t version = 0;
+
+	if (!record.GetFieldUint32(version))
+	{
+		return false;
+	}
+
+	ResourceTable loadedResources;
+
+	if (version == 1)
+	{
+		// Version 1 records are upgraded to version 2 the next time the region is saved.
+		if (!ReadResourceTable(record, loadedResources))
+		{
+			return false;
+		}
+	}
+	else if (version == 2)
+	{
+		uint32_t dataSize = 0;
+
+		if (!record.GetFieldUint32(dataSize) || dataSize > MaxEncodedResourceDataSize)
+		{
+			return false;
+		}
+
+		std::vector<uint8_t> storage;
+		std::span<const uint8_t> data;
+
+		if (!ReadEncodedData(record, dataSize, storage, data))
+		{
+			return false;
+		}
+
+#ifdef _DEBUG
+		const auto decodeStart = std::chrono::steady_clock::now();
+#endif // _DEBUG
+
+		if (!ResourceTableCodec::Decode(data.data(), data.size(), loadedResources))
+		{
+			return false;
+		}
+
+#ifdef _DEBUG
+		const std::chrono::duration<double> decodeTime = std::chrono::steady_clock::now() - decodeStart;
+
+		if (decodeTime.count() > 0.0)
+		{
+			LOG_INFO(
+				"Decoded %u resources (%u bytes) at %.1f MB/s.",
+				static_cast<uint32_t>(loadedResources.GetCount()),
+				dataSize,
+				(static_cast<double>(dataSize) / (1024.0 * 1024.0)) / decodeTime.count());
+		}
+#endif // _DEBUG
+	}
+	else
+	{
+		return false;
+	}
 
-	auto it = resources.find(resourceID);
+	resources.Assign(loadedResources);
+	return true;
+}
 
-	if (it != resources.end())
+bool RegionalSupplyManager::SaveToSerialRecord(cIGZPersistDBSerialRecord& record, const std::vector<uint8_t>& resourceData)
+{
+	if (!record.SetFieldUint32(2)) // version
 	{
-		supply = it->second;
+		return false;
 	}
 
-	return supply;
+	const uint32_t dataSize = static_cast<uint32_t>(resourceData.size());
+
+	return record.SetFieldUint32(dataSize) && record.SetFieldVoid(resourceData.data(), dataSize);
 }
 
-bool RegionalSupplyManager::LoadFromSerialRecord(cIGZPersistDBSerialRecord& record)
+template <typename TRecord>
+bool RegionalSupplyManager::LoadCityLedgersFromSerialRecord(TRecord& record)
 {
 	uint32_t version = 0;
 
-	if (!record.GetFieldUint32(version) || version != 1)
+	if (!record.GetFieldUint32(version) || version < 1 || version > 3)
+	{
+		return false;
+	}
+
+	// Version 2 added the snapshot sequence number that is used by the journal.
+	if (version >= 2 && !record.GetFieldUint32(snapshotSequence))
 	{
 		return false;
 	}
 
-	uint32_t itemCount = 0;
+	uint32_t cityCount = 0;
 
-	if (!record.GetFieldUint32(itemCount))
+	if (!record.GetFieldUint32(cityCount))
 	{
 		return false;
 	}
 
-	for (uint32_t i = 0; i < itemCount; i++)
+	for (uint32_t i = 0; i < cityCount; i++)
 	{
-		uint32_t resourceID = 0;
+		uint32_t nameLength = 0;
 
-		if (!record.GetFieldUint32(resourceID))
+		if (!record.GetFieldUint32(nameLength))
 		{
 			return false;
 		}
 
-		int64_t resourceQuantity = 0;
+		std::string cityID(nameLength, '\0');
 
-		if (!record.GetFieldSint64(resourceQuantity))
+		if (nameLength > 0 && !record.GetFieldVoid(cityID.data(), nameLength))
 		{
 			return false;
 		}
 
-		resources.emplace(resourceID, resourceQuantity);
+		// Version 3 changed the ledger key from the city name to the city's save file name.
+		if (version < 3)
+		{
+			cityID = MakeLegacyCityKey(cityID);
+		}
+
+		if (!ReadResourceTable(record, GetWritableLedger(GetOrAddCityLedger(cityID).second)))
+		{
+			return false;
+		}
 	}
 
 	return true;
 }
 
-bool RegionalSupplyManager::SaveToSerialRecord(cIGZPersistDBSerialRecord& record) const
+bool RegionalSupplyManager::SaveCityLedgersToSerialRecord(
+	cIGZPersistDBSerialRecord& record,
+	const CityLedgerMap& ledgers,
+	uint32_t sequence)
 {
-	if (!record.SetFieldUint32(1)) // version
+	if (!record.SetFieldUint32(3)) // version
+	{
+		return false;
+	}
+
+	if (!record.SetFieldUint32(sequence))
 	{
 		return false;
 	}
 
-	if (!record.SetFieldUint32(resources.size()))
+	if (!record.SetFieldUint32(static_cast<uint32_t>(ledgers.size())))
 	{
 		return false;
 	}
 
-	for (auto& item : resources)
+	for (const auto& item : ledgers)
 	{
-		if (!record.SetFieldUint32(item.first)) // resource id
+		const std::string& cityID = item.first;
+
+		if (!record.SetFieldUint32(static_cast<uint32_t>(cityID.size())))
 		{
 			return false;
 		}
 
-		if (!record.SetFieldSint64(item.second)) // resource quantity
+		if (!cityID.empty() && !record.SetFieldVoid(cityID.data(), static_cast<uint32_t>(cityID.size())))
+		{
+			return false;
+		}
+
+		if (!WriteResourceTable(record, *item.second))
 		{
 			return false;
 		}
@@ -204,3 +1371,48 @@ bool RegionalSupplyManager::SaveToSerialRecord(cIGZPersistDBSerialRecord& record
 
 	return true;
 }
+
+uint64_t RegionalSupplyManager::EncodeResources(std::vector<uint8_t>& resourceData) const
+{
+	// Other threads may be modifying the region totals, so the data is encoded
+	// from a copy. The generation is read first, a change that is made while the
+	// copy is taken will cause the next save check to compare the checksums.
+	const uint64_t copyGeneration = generation.load();
+
+	ResourceTable resourcesCopy;
+	resources.CopyTo(resourcesCopy);
+
+	ResourceTableCodec::Encode(resourcesCopy, resourceData);
+
+	return copyGeneration;
+}
+
+uint32_t RegionalSupplyManager::ComputeSnapshotChecksum(const std::vector<uint8_t>& resourceData, const CityLedgerMap& ledgers)
+{
+	uint32_t checksum = UpdateEncodedDataChecksum(resourceData, 0);
+
+	std::vector<uint8_t> ledgerData;
+
+	for (const auto& item : ledgers)
+	{
+		const std::string& cityName = item.first;
+
+		// The name length is included so that the name and ledger boundaries are unambiguous.
+		const uint32_t nameLength = static_cast<uint32_t>(cityName.size());
+
+		checksum = Crc32C::Compute(&nameLength, sizeof(nameLength), checksum);
+		checksum = Crc32C::Compute(cityName.data(), cityName.size(), checksum);
+
+		ResourceTableCodec::Encode(*item.second, ledgerData);
+		checksum = UpdateEncodedDataChecksum(ledgerData, checksum);
+	}
+
+	return checksum;
+}
+
+void RegionalSupplyManager::MarkPersisted(uint64_t persistedGeneration, uint32_t persistedChecksum)
+{
+	lastPersistedGeneration = persistedGeneration;
+	lastPersistedChecksum = persistedChecksum;
+	persistedSnapshotCommitted = true;
+}
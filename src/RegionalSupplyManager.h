@@ -21,17 +21,122 @@
 
 #pragma once
 #include "IRegionalSupplyManager.h"
-#include <unordered_map>
+#include "RegionalSupplyJournal.h"
+#include "RegionStateCache.h"
+#include "ResourceWatchList.h"
+#include "ResourceTable.h"
+#include "ShardedResourceTable.h"
+#include "cIGZPersistDBSegment.h"
+#include "cRZAutoRefCount.h"
+#include "cRZBaseSystemService.h"
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
 
-class cIGZPersistDBSegment;
 class cIGZPersistDBSerialRecord;
 class cIGZString;
 
-class RegionalSupplyManager : public IRegionalSupplyManager
+// The IRegionalSupplyManager methods can be called from any thread.
+// The load/save and city ledger methods must only be called from the game thread.
+// The manager is registered as a GZCOM system service so that other DLLs can
+// call the IRegionalSupplyManager2 methods directly.
+class RegionalSupplyManager : public cRZBaseSystemService, public IRegionalSupplyManager2
 {
 public:
-	void Load(cIGZPersistDBSegment* pSegment);
-	void Save(cIGZPersistDBSegment* pSegment) const;
+	struct SaveResult
+	{
+		bool succeeded;
+		// True if the data matched the last saved snapshot, the data file is not
+		// rewritten in that case.
+		bool unchanged;
+		// The time that the game thread was blocked by SaveAsync, this includes
+		// waiting for the previous save and taking the snapshot.
+		double snapshotMilliseconds;
+		// The time that the worker thread spent writing the snapshot.
+		double writeMilliseconds;
+	};
+
+	using SaveCompletionCallback = std::function<void(const SaveResult&)>;
+	using WatchEventHandler = std::function<void(std::span<const ResourceWatchList::Event>)>;
+	using JournalCompactionHandler = std::function<void()>;
+
+	RegionalSupplyManager();
+	~RegionalSupplyManager();
+
+	// Loads the region data and its journal on a worker thread.
+	// The data file is read through a memory mapping when possible, pSegment is
+	// used as a fallback and must be initialized but not opened.
+	// pSegment can be nullptr and dataFilePath can be empty if the region does not
+	// have a data file. The other methods wait for the load to finish if they are
+	// called before the data is ready.
+	void LoadAsync(cIGZPersistDBSegment* pSegment, const std::filesystem::path& dataFilePath);
+
+	// Takes a snapshot of the resource data and writes it to the segment on a worker thread.
+	// pSegment must be initialized but not opened, the worker opens it if the data
+	// differs from the last saved snapshot.
+	// The callback is called on the worker thread when the save has finished.
+	void SaveAsync(cIGZPersistDBSegment* pSegment, SaveCompletionCallback callback);
+	// Blocks until the pending save, if any, has finished.
+	void WaitForPendingSave();
+
+	// Returns true if the resource data changed since the last loaded or saved snapshot.
+	// This does not wait for a pending save. The data can return to its saved state,
+	// so the save worker compares the snapshot checksums before it writes the data.
+	bool CheckForUnsavedChanges();
+
+	void CloseJournal();
+	void FlushJournal();
+	// Returns true if the journal is large enough that a new snapshot should be saved.
+	bool IsJournalCompactionNeeded() const;
+
+	// Starts tracking the building contributions of the specified city.
+	// cityID is the file name of the city's save file, or an empty string if the
+	// city has not been saved yet. cityName is only used to find the ledgers that
+	// older versions of the plugin keyed by the city name.
+	// buildingTotals are the combined deltas of every building in the freshly
+	// loaded city, the region totals are adjusted by the difference between them
+	// and the city's saved ledger.
+	void BeginCitySession(
+		std::string_view cityID,
+		std::string_view cityName,
+		std::span<const ResourceDelta> buildingTotals);
+	// Sets the id of a city that was saved for the first time during the current session.
+	void AssignActiveCityID(std::string_view cityID);
+	// Ends the current city session. The game discards a city that was never saved,
+	// so its building contributions are removed from the region.
+	void EndCitySession();
+
+	// Applies the deltas of a building that was added to or removed from the current city.
+	// The deltas are recorded in both the region totals and the city's ledger.
+	void ApplyBuildingDeltas(std::span<const ResourceDelta> deltas);
+
+	// The Lua threshold watches, the crossings are reported to the watch event handler.
+	ResourceWatchList& GetWatchList();
+	// Sets the function that receives the queued watch events once per tick.
+	void SetWatchEventHandler(WatchEventHandler handler);
+	// Sets the function that is called from the tick when IsJournalCompactionNeeded
+	// returns true, it should start a save of the region data.
+	void SetJournalCompactionHandler(JournalCompactionHandler handler);
+
+	// cIGZSystemService
+
+	bool OnTick(uint32_t unknown);
+
+	// cIGZUnknown
+
+	bool QueryInterface(uint32_t riid, void** ppvObj);
+	uint32_t AddRef();
+	uint32_t Release();
 
 	// IRegionalSupplyManager
 
@@ -42,10 +147,125 @@ public:
 
 	int64_t GetResourceQuantity(uint32_t resourceID) const;
 
+	using IRegionalSupplyManager::ApplyDeltas;
+	void ApplyDeltas(const ResourceDelta* pDeltas, size_t count);
+
+	// IRegionalSupplyManager2
+
+	uint64_t GetGeneration() const;
+	uint64_t GetResourceGeneration(uint32_t resourceID) const;
+
 private:
-	bool LoadFromSerialRecord(cIGZPersistDBSerialRecord& record);
-	bool SaveToSerialRecord(cIGZPersistDBSerialRecord& record) const;
+	// Resets the manager to an empty region that has no unsaved changes.
+	void Clear();
+	void Load(cIGZPersistDBSegment* pSegment);
+	// Returns false if the file cannot be read without the packed file segment.
+	bool LoadMappedFile(const std::filesystem::path& dataFilePath);
+	template <typename TReadRecord> void LoadRecords(TReadRecord&& readRecord);
+	void LoadRegion(cIGZPersistDBSegment* pSegment, const std::filesystem::path& dataFilePath);
+
+	// Moves the state of the loaded region into the region state cache.
+	void CacheLoadedRegion();
+	// Returns false if the region state cache does not have a valid entry for the region.
+	bool RestoreCachedRegion(const std::filesystem::path& dataFilePath);
+
+	// Opens the change journal and replays the changes that were made after
+	// the loaded snapshot was saved.
+	void OpenJournal(const std::filesystem::path& path);
+
+	// Waits for the pending load if the data is not ready yet.
+	void EnsureLoaded() const;
+	void WaitForPendingLoad() const;
+
+	void ApplyDeltasCore(const ResourceDelta* pDeltas, size_t count, ResourceTable* pCityLedger);
+
+	// Called when the region totals are replaced, this changes the generation of every resource.
+	void ResetResourceGenerations();
+
+	// The city ledgers are shared with the save snapshot, a ledger is copied
+	// the first time it is modified after the snapshot was taken.
+	using CityLedgerMap = RegionState::CityLedgerMap;
+
+	struct SaveSnapshot
+	{
+		explicit SaveSnapshot(cIGZPersistDBSegment* pSegment);
+
+		cRZAutoRefCount<cIGZPersistDBSegment> segment;
+		ResourceTable resources;
+		CityLedgerMap cityLedgers;
+		std::string activeCityName;
+		bool hasActiveCity;
+		uint64_t generation;
+		uint32_t sequence;
+		size_t journalEntryCount;
+	};
+
+	CityLedgerMap::value_type& GetOrAddCityLedger(std::string_view cityID);
+	// Moves the city's ledger to the specified id, replacing any existing ledger with that id.
+	CityLedgerMap::value_type& RenameCityLedger(CityLedgerMap::value_type& city, std::string_view cityID);
+	// Removes the city's building contributions from the region totals and its ledger.
+	void RemoveCityContributions(CityLedgerMap::value_type& city);
+	// Removes the ledger of a city that was never saved.
+	void DiscardUnsavedCity();
+	ResourceTable& GetWritableLedger(std::shared_ptr<ResourceTable>& ledger);
+
+	void WriteSnapshot(const SaveSnapshot& snapshot, SaveResult& result);
+	bool IsSavePending() const;
+
+	template <typename TRecord> bool LoadFromSerialRecord(TRecord& record);
+	static bool SaveToSerialRecord(cIGZPersistDBSerialRecord& record, const std::vector<uint8_t>& resourceData);
+
+	template <typename TRecord> bool LoadCityLedgersFromSerialRecord(TRecord& record);
+	static bool SaveCityLedgersToSerialRecord(
+		cIGZPersistDBSerialRecord& record,
+		const CityLedgerMap& ledgers,
+		uint32_t sequence);
+
+	// Encodes a copy of the region totals and returns the generation of the copy.
+	uint64_t EncodeResources(std::vector<uint8_t>& resourceData) const;
+	static uint32_t ComputeSnapshotChecksum(const std::vector<uint8_t>& resourceData, const CityLedgerMap& ledgers);
+	void MarkPersisted(uint64_t persistedGeneration, uint32_t persistedChecksum);
 
-	std::unordered_map<uint32_t, int64_t> resources;
+	// The region totals, this is the sum of the city ledgers and the changes
+	// made through the Lua/native APIs.
+	ShardedResourceTable resources;
+	// The building contributions of each city, keyed by the file name of the city's save file.
+	// The city that is being played before its first save uses an empty id.
+	CityLedgerMap cityLedgers;
+	CityLedgerMap::value_type* pActiveCity;
+	// The ledgers that were shared with the last save snapshot and have not been
+	// copied since, this is updated while the update lock is held exclusively.
+	std::unordered_set<const ResourceTable*> snapshotLedgers;
+	RegionalSupplyJournal journal;
+	RegionStateCache regionStateCache;
+	ResourceWatchList watchList;
+	WatchEventHandler watchEventHandler;
+	std::vector<ResourceWatchList::Event> watchEvents;
+	JournalCompactionHandler journalCompactionHandler;
+	std::filesystem::path loadedDataFilePath;
+	// Held in shared mode while the resources are updated and in exclusive mode
+	// while a save snapshot is taken, this keeps the snapshot and journal in sync.
+	std::shared_mutex updateMutex;
+	// The pending load, the other members must not be accessed until it has finished.
+	mutable std::mutex loadMutex;
+	mutable std::future<void> pendingLoad;
+	mutable std::atomic<bool> loadPending;
+	// The pending save. The fields below are written by the save worker,
+	// the game thread waits for the save before it accesses them.
+	std::future<void> pendingSave;
+	// Identifies the saved snapshot that the journal entries apply to.
+	uint32_t snapshotSequence;
+	// Incremented whenever the region totals or city ledgers change.
+	std::atomic<uint64_t> generation;
+	// The generation of the last change to each resource. Resources that have not
+	// changed since the region totals were replaced use the base generation.
+	ShardedResourceTable resourceGenerations;
+	std::atomic<uint64_t> resourceGenerationBase;
+	// The generation and checksum of the last loaded or saved snapshot.
+	uint64_t lastPersistedGeneration;
+	uint32_t lastPersistedChecksum;
+	// False after a save has started to rewrite the data file and has not committed it,
+	// the file may then no longer hold the snapshot that the checksum describes.
+	bool persistedSnapshotCommitted;
 };
 
@@ -0,0 +1,71 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ResourceDeltaUtil.h"
+#include <algorithm>
+
+bool ResourceDeltaUtil::IsSortedAndUnique(const ResourceDelta* pDeltas, size_t count)
+{
+	for (size_t i = 1; i < count; i++)
+	{
+		if (pDeltas[i - 1].resourceID >= pDeltas[i].resourceID)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+size_t ResourceDeltaUtil::SortAndMerge(ResourceDelta* pDeltas, size_t count)
+{
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	std::sort(
+		pDeltas,
+		pDeltas + count,
+		[](const ResourceDelta& lhs, const ResourceDelta& rhs)
+		{
+			return lhs.resourceID < rhs.resourceID;
+		});
+
+	size_t mergedCount = 1;
+
+	for (size_t i = 1; i < count; i++)
+	{
+		ResourceDelta& last = pDeltas[mergedCount - 1];
+
+		if (pDeltas[i].resourceID == last.resourceID)
+		{
+			last.amount += pDeltas[i].amount;
+		}
+		else
+		{
+			pDeltas[mergedCount] = pDeltas[i];
+			mergedCount++;
+		}
+	}
+
+	return mergedCount;
+}
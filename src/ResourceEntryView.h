@@ -0,0 +1,114 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <cstdint>
+#include <iterator>
+
+struct ResourceEntry
+{
+	uint32_t id;
+	uint32_t amount;
+};
+
+// A read-only view of the id/amount pairs in a Uint32 array property.
+// The entries are read in place from the property value, nothing is copied.
+class ResourceEntryView
+{
+public:
+	class Iterator
+	{
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = ResourceEntry;
+		using difference_type = std::ptrdiff_t;
+		using pointer = void;
+		using reference = ResourceEntry;
+
+		Iterator() : pData(nullptr)
+		{
+		}
+
+		explicit Iterator(const uint32_t* pData) : pData(pData)
+		{
+		}
+
+		ResourceEntry operator*() const
+		{
+			return ResourceEntry{ pData[0], pData[1] };
+		}
+
+		Iterator& operator++()
+		{
+			pData += 2;
+			return *this;
+		}
+
+		Iterator operator++(int)
+		{
+			Iterator temp = *this;
+			pData += 2;
+			return temp;
+		}
+
+		bool operator==(const Iterator& other) const
+		{
+			return pData == other.pData;
+		}
+
+	private:
+		const uint32_t* pData;
+	};
+
+	ResourceEntryView() : pData(nullptr), entryCount(0)
+	{
+	}
+
+	// pData must point to entryCount id/amount pairs.
+	ResourceEntryView(const uint32_t* pData, uint32_t entryCount)
+		: pData(pData), entryCount(entryCount)
+	{
+	}
+
+	Iterator begin() const
+	{
+		return Iterator(pData);
+	}
+
+	Iterator end() const
+	{
+		return Iterator(pData + (static_cast<size_t>(entryCount) * 2));
+	}
+
+	uint32_t size() const
+	{
+		return entryCount;
+	}
+
+	bool empty() const
+	{
+		return entryCount == 0;
+	}
+
+private:
+	const uint32_t* pData;
+	uint32_t entryCount;
+};
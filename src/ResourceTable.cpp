@@ -0,0 +1,267 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ResourceTable.h"
+#include <algorithm>
+#include <bit>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define RESOURCE_TABLE_USE_SSE2 1
+#endif
+
+namespace
+{
+	// The initial hash table size is 4 times the small table limit, this keeps the
+	// load factor low enough that a probe sequence rarely leaves its cache line.
+	constexpr size_t InitialHashCapacity = ResourceTable::SmallTableMaxCount * 4;
+
+	uint32_t HashResourceID(uint32_t id, uint32_t shift)
+	{
+		// Fibonacci hashing, the resource ids are expected to be random
+		// but mods may also use sequential ids.
+		return (id * 0x9E3779B1U) >> shift;
+	}
+}
+
+ResourceTable::ResourceTable()
+	: smallIDs(),
+	  smallQuantities(),
+	  hashSlots(),
+	  hashCount(0),
+	  hashShift(32)
+{
+}
+
+bool ResourceTable::IsEmpty() const
+{
+	return GetCount() == 0;
+}
+
+size_t ResourceTable::GetCount() const
+{
+	return hashSlots.empty() ? smallIDs.size() : hashCount;
+}
+
+size_t ResourceTable::GetMemoryUsage() const
+{
+	return sizeof(*this)
+		+ (smallIDs.capacity() * sizeof(uint32_t))
+		+ (smallQuantities.capacity() * sizeof(int64_t))
+		+ (hashSlots.capacity() * sizeof(HashSlot));
+}
+
+void ResourceTable::Clear()
+{
+	smallIDs.clear();
+	smallQuantities.clear();
+	hashSlots.clear();
+	hashCount = 0;
+	hashShift = 32;
+}
+
+int64_t ResourceTable::Get(uint32_t id) const
+{
+	int64_t quantity = 0;
+
+	if (hashSlots.empty())
+	{
+		const size_t index = FindSmallIndex(id);
+
+		if (index != NotFound)
+		{
+			quantity = smallQuantities[index];
+		}
+	}
+	else
+	{
+		const HashSlot* slot = FindHashSlot(id);
+
+		if (slot)
+		{
+			quantity = slot->quantity;
+		}
+	}
+
+	return quantity;
+}
+
+int64_t ResourceTable::Add(uint32_t id, int64_t amount)
+{
+	int64_t* quantity = FindOrInsert(id);
+
+	*quantity += amount;
+
+	return *quantity;
+}
+
+void ResourceTable::Set(uint32_t id, int64_t quantity)
+{
+	*FindOrInsert(id) = quantity;
+}
+
+size_t ResourceTable::FindSmallIndex(uint32_t id) const
+{
+	const uint32_t* const ids = smallIDs.data();
+	const size_t count = smallIDs.size();
+
+	size_t i = 0;
+
+#if RESOURCE_TABLE_USE_SSE2
+	const __m128i needle = _mm_set1_epi32(static_cast<int>(id));
+
+	for (; (i + 4) <= count; i += 4)
+	{
+		const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ids + i));
+		const int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(values, needle)));
+
+		if (mask != 0)
+		{
+			return i + static_cast<size_t>(std::countr_zero(static_cast<uint32_t>(mask)));
+		}
+	}
+#endif // RESOURCE_TABLE_USE_SSE2
+
+	for (; i < count; i++)
+	{
+		if (ids[i] == id)
+		{
+			return i;
+		}
+	}
+
+	return NotFound;
+}
+
+int64_t* ResourceTable::FindOrInsert(uint32_t id)
+{
+	if (hashSlots.empty())
+	{
+		const size_t index = FindSmallIndex(id);
+
+		if (index != NotFound)
+		{
+			return &smallQuantities[index];
+		}
+
+		if (smallIDs.size() < SmallTableMaxCount)
+		{
+			// Keep the small table sorted so that the enumeration order is stable.
+			const auto it = std::lower_bound(smallIDs.begin(), smallIDs.end(), id);
+			const size_t insertIndex = static_cast<size_t>(it - smallIDs.begin());
+
+			smallIDs.insert(it, id);
+			smallQuantities.insert(smallQuantities.begin() + insertIndex, 0);
+
+			return &smallQuantities[insertIndex];
+		}
+
+		PromoteToHashTable();
+	}
+	else
+	{
+		HashSlot& existingSlot = FindHashSlot(id);
+
+		if (existingSlot.occupied)
+		{
+			return &existingSlot.quantity;
+		}
+	}
+
+	// The table only grows when a new id is inserted.
+	// Keep the load factor at or below 75%.
+	if (((hashCount + 1) * 4) > (hashSlots.size() * 3))
+	{
+		ResizeHashTable(hashSlots.size() * 2);
+	}
+
+	HashSlot& slot = FindHashSlot(id);
+
+	slot.id = id;
+	slot.occupied = 1;
+	slot.quantity = 0;
+	hashCount++;
+
+	return &slot.quantity;
+}
+
+void ResourceTable::PromoteToHashTable()
+{
+	std::vector<uint32_t> ids;
+	std::vector<int64_t> quantities;
+
+	ids.swap(smallIDs);
+	quantities.swap(smallQuantities);
+
+	ResizeHashTable(InitialHashCapacity);
+
+	for (size_t i = 0; i < ids.size(); i++)
+	{
+		HashSlot& slot = FindHashSlot(ids[i]);
+
+		slot.id = ids[i];
+		slot.occupied = 1;
+		slot.quantity = quantities[i];
+		hashCount++;
+	}
+}
+
+void ResourceTable::ResizeHashTable(size_t newCapacity)
+{
+	std::vector<HashSlot> oldSlots(newCapacity, HashSlot{});
+
+	oldSlots.swap(hashSlots);
+	hashCount = 0;
+	hashShift = 32 - static_cast<uint32_t>(std::countr_zero(newCapacity));
+
+	for (const HashSlot& oldSlot : oldSlots)
+	{
+		if (oldSlot.occupied)
+		{
+			HashSlot& slot = FindHashSlot(oldSlot.id);
+
+			slot = oldSlot;
+			hashCount++;
+		}
+	}
+}
+
+ResourceTable::HashSlot& ResourceTable::FindHashSlot(uint32_t id)
+{
+	const size_t mask = hashSlots.size() - 1;
+	size_t index = HashResourceID(id, hashShift);
+
+	// The table is never full, so the probe always ends at the
+	// requested id or an empty slot.
+	while (hashSlots[index].occupied && hashSlots[index].id != id)
+	{
+		index = (index + 1) & mask;
+	}
+
+	return hashSlots[index];
+}
+
+const ResourceTable::HashSlot* ResourceTable::FindHashSlot(uint32_t id) const
+{
+	const HashSlot& slot = const_cast<ResourceTable*>(this)->FindHashSlot(id);
+
+	return slot.occupied ? &slot : nullptr;
+}
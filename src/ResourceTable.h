@@ -0,0 +1,114 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Maps a resource id to its quantity.
+//
+// Most regions only use a handful of resources, so the table starts out as a
+// sorted array that is searched with a SIMD linear scan. When the resource count
+// grows past SmallTableMaxCount the table is promoted to an open-addressing hash
+// table with linear probing.
+// Resources are never removed from the table, a resource with a quantity of zero
+// is still considered to be present.
+class ResourceTable
+{
+public:
+	ResourceTable();
+
+	bool IsEmpty() const;
+	size_t GetCount() const;
+	// Gets the approximate number of bytes that the table uses.
+	size_t GetMemoryUsage() const;
+
+	void Clear();
+
+	int64_t Get(uint32_t id) const;
+
+	// Adds the specified amount to the resource quantity and returns the new quantity.
+	int64_t Add(uint32_t id, int64_t amount);
+
+	void Set(uint32_t id, int64_t quantity);
+
+	// Calls func(id, quantity) for each resource in the table.
+	// The enumeration stops when func returns false, in which case this method
+	// also returns false.
+	template <typename Func> bool ForEach(Func&& func) const
+	{
+		if (hashSlots.empty())
+		{
+			for (size_t i = 0; i < smallIDs.size(); i++)
+			{
+				if (!func(smallIDs[i], smallQuantities[i]))
+				{
+					return false;
+				}
+			}
+		}
+		else
+		{
+			for (const HashSlot& slot : hashSlots)
+			{
+				if (slot.occupied)
+				{
+					if (!func(slot.id, slot.quantity))
+					{
+						return false;
+					}
+				}
+			}
+		}
+
+		return true;
+	}
+
+	static constexpr size_t SmallTableMaxCount = 32;
+
+private:
+	struct HashSlot
+	{
+		uint32_t id;
+		uint32_t occupied;
+		int64_t quantity;
+	};
+
+	static constexpr size_t NotFound = static_cast<size_t>(-1);
+
+	size_t FindSmallIndex(uint32_t id) const;
+	int64_t* FindOrInsert(uint32_t id);
+
+	void PromoteToHashTable();
+	void ResizeHashTable(size_t newCapacity);
+	HashSlot& FindHashSlot(uint32_t id);
+	const HashSlot* FindHashSlot(uint32_t id) const;
+
+	// The small table is stored as separate id and quantity arrays
+	// so that the id search can compare 4 ids per instruction.
+	std::vector<uint32_t> smallIDs;
+	std::vector<int64_t> smallQuantities;
+
+	std::vector<HashSlot> hashSlots;
+	size_t hashCount;
+	uint32_t hashShift;
+};
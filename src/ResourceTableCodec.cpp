@@ -0,0 +1,173 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ResourceTableCodec.h"
+#include "Crc32C.h"
+#include <algorithm>
+
+namespace
+{
+	constexpr size_t ChecksumSize = sizeof(uint32_t);
+
+	struct ResourceItem
+	{
+		uint32_t id;
+		int64_t quantity;
+	};
+
+	void WriteVarint(std::vector<uint8_t>& output, uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			output.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+
+		output.push_back(static_cast<uint8_t>(value));
+	}
+
+	bool ReadVarint(const uint8_t*& p, const uint8_t* end, uint64_t& value)
+	{
+		uint64_t result = 0;
+
+		// A 64-bit value uses at most 10 bytes.
+		for (uint32_t shift = 0; shift < 70 && p < end; shift += 7)
+		{
+			const uint8_t byte = *p++;
+
+			result |= static_cast<uint64_t>(byte & 0x7F) << shift;
+
+			if ((byte & 0x80) == 0)
+			{
+				value = result;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	uint64_t ZigZagEncode(int64_t value)
+	{
+		return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+	}
+
+	int64_t ZigZagDecode(uint64_t value)
+	{
+		return static_cast<int64_t>((value >> 1) ^ (~(value & 1) + 1));
+	}
+}
+
+void ResourceTableCodec::Encode(const ResourceTable& table, std::vector<uint8_t>& output)
+{
+	std::vector<ResourceItem> items;
+	items.reserve(table.GetCount());
+
+	table.ForEach([&](uint32_t id, int64_t quantity)
+	{
+		items.emplace_back(id, quantity);
+		return true;
+	});
+
+	std::sort(
+		items.begin(),
+		items.end(),
+		[](const ResourceItem& a, const ResourceItem& b) { return a.id < b.id; });
+
+	output.clear();
+	// Most items fit in 1-3 bytes for the id delta and 1-5 bytes for the quantity.
+	output.reserve(5 + (items.size() * 8) + ChecksumSize);
+
+	WriteVarint(output, items.size());
+
+	uint32_t previousID = 0;
+
+	for (const ResourceItem& item : items)
+	{
+		WriteVarint(output, item.id - previousID);
+		WriteVarint(output, ZigZagEncode(item.quantity));
+		previousID = item.id;
+	}
+
+	const uint32_t checksum = Crc32C::Compute(output.data(), output.size());
+
+	for (size_t i = 0; i < ChecksumSize; i++)
+	{
+		output.push_back(static_cast<uint8_t>(checksum >> (i * 8)));
+	}
+}
+
+bool ResourceTableCodec::Decode(const uint8_t* data, size_t size, ResourceTable& table)
+{
+	if (size < ChecksumSize)
+	{
+		return false;
+	}
+
+	const size_t payloadSize = size - ChecksumSize;
+	const uint8_t* const checksumBytes = data + payloadSize;
+
+	const uint32_t expectedChecksum = static_cast<uint32_t>(checksumBytes[0])
+		| (static_cast<uint32_t>(checksumBytes[1]) << 8)
+		| (static_cast<uint32_t>(checksumBytes[2]) << 16)
+		| (static_cast<uint32_t>(checksumBytes[3]) << 24);
+
+	if (Crc32C::Compute(data, payloadSize) != expectedChecksum)
+	{
+		return false;
+	}
+
+	const uint8_t* p = data;
+	const uint8_t* const end = data + payloadSize;
+
+	uint64_t itemCount = 0;
+
+	// Each item uses at least 2 bytes.
+	if (!ReadVarint(p, end, itemCount) || itemCount > (payloadSize / 2))
+	{
+		return false;
+	}
+
+	uint64_t id = 0;
+
+	for (uint64_t i = 0; i < itemCount; i++)
+	{
+		uint64_t idDelta = 0;
+		uint64_t quantity = 0;
+
+		if (!ReadVarint(p, end, idDelta) || !ReadVarint(p, end, quantity))
+		{
+			return false;
+		}
+
+		id += idDelta;
+
+		// The ids are unique and must fit in 32 bits.
+		if ((i > 0 && idDelta == 0) || id > UINT32_MAX)
+		{
+			return false;
+		}
+
+		table.Set(static_cast<uint32_t>(id), ZigZagDecode(quantity));
+	}
+
+	return p == end;
+}
@@ -0,0 +1,39 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include "ResourceTable.h"
+#include <vector>
+
+// Encodes a resource table in the compact format that is used by version 2
+// of the region resource record.
+//
+// The format is a varint resource count followed by the resources sorted by id.
+// Each resource is stored as a varint of the difference from the previous id
+// and a zigzag varint of the quantity. A little-endian CRC-32C of the preceding
+// bytes is appended to the end of the data.
+namespace ResourceTableCodec
+{
+	void Encode(const ResourceTable& table, std::vector<uint8_t>& output);
+
+	// Returns false if the data is truncated, malformed or has an invalid checksum.
+	bool Decode(const uint8_t* data, size_t size, ResourceTable& table);
+}
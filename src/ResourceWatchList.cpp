@@ -0,0 +1,164 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ResourceWatchList.h"
+#include <algorithm>
+
+ResourceWatchList::ResourceWatchList()
+	: mutex(),
+	  watches(),
+	  thresholds(),
+	  pendingWatches(),
+	  hasWatches(false)
+{
+}
+
+void ResourceWatchList::Add(uint32_t resourceID, int64_t low, int64_t high, std::string_view callbackName)
+{
+	std::scoped_lock lock(mutex);
+
+	const auto it = std::ranges::find_if(watches, [&](const Watch& watch)
+	{
+		return watch.resourceID == resourceID && watch.callbackName == callbackName;
+	});
+
+	size_t watchIndex = static_cast<size_t>(it - watches.begin());
+
+	if (it != watches.end())
+	{
+		std::erase_if(thresholds[resourceID], [&](const Threshold& threshold)
+		{
+			return threshold.watchIndex == watchIndex;
+		});
+
+		it->low = low;
+		it->high = high;
+	}
+	else
+	{
+		watches.emplace_back(resourceID, low, high, std::string(callbackName), false, 0);
+	}
+
+	AddThreshold(resourceID, low, watchIndex);
+
+	if (high != low)
+	{
+		AddThreshold(resourceID, high, watchIndex);
+	}
+
+	hasWatches.store(true, std::memory_order_release);
+}
+
+void ResourceWatchList::Clear()
+{
+	std::scoped_lock lock(mutex);
+
+	hasWatches.store(false, std::memory_order_release);
+	watches.clear();
+	thresholds.clear();
+	pendingWatches.clear();
+}
+
+bool ResourceWatchList::HasWatches() const
+{
+	return hasWatches.load(std::memory_order_acquire);
+}
+
+void ResourceWatchList::OnQuantitiesChanged(const QuantityChange* pChanges, size_t count)
+{
+	if (!HasWatches() || count == 0)
+	{
+		return;
+	}
+
+	std::scoped_lock lock(mutex);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		OnQuantityChangedLocked(pChanges[i]);
+	}
+}
+
+void ResourceWatchList::OnQuantityChangedLocked(const QuantityChange& change)
+{
+	const uint32_t resourceID = change.resourceID;
+	const int64_t oldQuantity = change.oldQuantity;
+	const int64_t newQuantity = change.newQuantity;
+
+	if (oldQuantity == newQuantity)
+	{
+		return;
+	}
+
+	const auto it = thresholds.find(resourceID);
+
+	if (it == thresholds.end())
+	{
+		return;
+	}
+
+	const std::vector<Threshold>& resourceThresholds = it->second;
+
+	// A threshold is crossed when it is in the (min, max] range, i.e. the
+	// quantity moved from below the threshold to at or above it, or back.
+	const int64_t min = std::min(oldQuantity, newQuantity);
+	const int64_t max = std::max(oldQuantity, newQuantity);
+
+	const auto first = std::ranges::upper_bound(resourceThresholds, min, {}, &Threshold::value);
+	const auto last = std::ranges::upper_bound(first, resourceThresholds.end(), max, {}, &Threshold::value);
+
+	for (auto threshold = first; threshold != last; ++threshold)
+	{
+		Watch& watch = watches[threshold->watchIndex];
+
+		if (!watch.eventPending)
+		{
+			watch.eventPending = true;
+			pendingWatches.push_back(threshold->watchIndex);
+		}
+
+		watch.eventQuantity = newQuantity;
+	}
+}
+
+void ResourceWatchList::TakePendingEvents(std::vector<Event>& events)
+{
+	std::scoped_lock lock(mutex);
+
+	for (size_t watchIndex : pendingWatches)
+	{
+		Watch& watch = watches[watchIndex];
+
+		events.emplace_back(watch.resourceID, watch.eventQuantity, watch.callbackName);
+		watch.eventPending = false;
+	}
+
+	pendingWatches.clear();
+}
+
+void ResourceWatchList::AddThreshold(uint32_t resourceID, int64_t value, size_t watchIndex)
+{
+	std::vector<Threshold>& resourceThresholds = thresholds[resourceID];
+
+	const auto position = std::ranges::upper_bound(resourceThresholds, value, {}, &Threshold::value);
+
+	resourceThresholds.emplace(position, value, watchIndex);
+}
@@ -0,0 +1,105 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Tracks the resource quantity thresholds that Lua scripts are watching.
+//
+// Each watch has a low and a high threshold. The thresholds of a resource are
+// kept sorted by value, so a quantity change only visits the thresholds that
+// lie between the old and new quantity.
+// A threshold is crossed when the old and new quantities are on different sides
+// of it, the crossings are queued until the game thread takes them.
+class ResourceWatchList
+{
+public:
+	struct Event
+	{
+		uint32_t resourceID;
+		// The quantity after the most recent crossing.
+		int64_t quantity;
+		std::string callbackName;
+	};
+
+	struct QuantityChange
+	{
+		uint32_t resourceID;
+		int64_t oldQuantity;
+		int64_t newQuantity;
+	};
+
+	ResourceWatchList();
+
+	ResourceWatchList(const ResourceWatchList&) = delete;
+	ResourceWatchList& operator=(const ResourceWatchList&) = delete;
+
+	// Adds a watch, or replaces the thresholds of an existing watch that
+	// has the same resource id and callback name.
+	void Add(uint32_t resourceID, int64_t low, int64_t high, std::string_view callbackName);
+	// Removes the watches and any events that have not been taken.
+	void Clear();
+
+	// Lets the callers skip collecting the quantity changes when nothing is being watched.
+	bool HasWatches() const;
+
+	// Queues an event for each watch whose thresholds were crossed.
+	// This method can be called from any thread.
+	void OnQuantitiesChanged(const QuantityChange* pChanges, size_t count);
+
+	// Moves the queued events into the events vector, each watch has at most one event.
+	void TakePendingEvents(std::vector<Event>& events);
+
+private:
+	struct Watch
+	{
+		uint32_t resourceID;
+		int64_t low;
+		int64_t high;
+		std::string callbackName;
+		bool eventPending;
+		int64_t eventQuantity;
+	};
+
+	struct Threshold
+	{
+		int64_t value;
+		size_t watchIndex;
+	};
+
+	void AddThreshold(uint32_t resourceID, int64_t value, size_t watchIndex);
+	void OnQuantityChangedLocked(const QuantityChange& change);
+
+	std::mutex mutex;
+	std::vector<Watch> watches;
+	// The thresholds of each resource, sorted by value.
+	std::unordered_map<uint32_t, std::vector<Threshold>> thresholds;
+	// The indices of the watches that have a pending event.
+	std::vector<size_t> pendingWatches;
+	// Lets OnQuantitiesChanged skip the lock when nothing is being watched.
+	std::atomic<bool> hasWatches;
+};
@@ -0,0 +1,338 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ShardedResourceTable.h"
+
+namespace
+{
+	constexpr size_t InitialShardCapacity = 16;
+	constexpr uint32_t ShardIndexBits = 4;
+
+	static_assert((size_t(1) << ShardIndexBits) == ShardedResourceTable::ShardCount);
+}
+
+ShardedResourceTable::SlotArray::SlotArray(size_t capacity)
+	: capacity(capacity),
+	  slots(std::make_unique<Slot[]>(capacity))
+{
+	for (size_t i = 0; i < capacity; i++)
+	{
+		slots[i].id.store(0, std::memory_order_relaxed);
+		slots[i].occupied.store(0, std::memory_order_relaxed);
+		slots[i].quantity.store(0, std::memory_order_relaxed);
+	}
+}
+
+ShardedResourceTable::Shard::Shard()
+	: writeMutex(),
+	  pSlots(nullptr),
+	  count(0),
+	  activeReaders(0),
+	  currentSlots(std::make_unique<SlotArray>(InitialShardCapacity)),
+	  retiredSlots()
+{
+	pSlots.store(currentSlots.get(), std::memory_order_release);
+}
+
+ShardedResourceTable::ShardReadScope::ShardReadScope(const Shard& shard) : shard(shard)
+{
+	// The reader count and slot pointer use sequentially consistent operations so that
+	// either the writer sees this reader, or this reader sees the writer's new slot array.
+	shard.activeReaders.fetch_add(1, std::memory_order_seq_cst);
+}
+
+ShardedResourceTable::ShardReadScope::~ShardReadScope()
+{
+	shard.activeReaders.fetch_sub(1, std::memory_order_release);
+}
+
+const ShardedResourceTable::SlotArray* ShardedResourceTable::ShardReadScope::GetSlots() const
+{
+	return shard.pSlots.load(std::memory_order_seq_cst);
+}
+
+ShardedResourceTable::ShardedResourceTable() : shards()
+{
+}
+
+bool ShardedResourceTable::IsEmpty() const
+{
+	return GetCount() == 0;
+}
+
+size_t ShardedResourceTable::GetCount() const
+{
+	size_t count = 0;
+
+	for (const Shard& shard : shards)
+	{
+		count += shard.count.load(std::memory_order_acquire);
+	}
+
+	return count;
+}
+
+void ShardedResourceTable::Clear()
+{
+	for (Shard& shard : shards)
+	{
+		std::scoped_lock lock(shard.writeMutex);
+
+		if (shard.count.load(std::memory_order_relaxed) > 0)
+		{
+			ReplaceSlotsLocked(shard, std::make_unique<SlotArray>(InitialShardCapacity));
+			shard.count.store(0, std::memory_order_release);
+		}
+
+		ReclaimRetiredSlotsLocked(shard);
+	}
+}
+
+int64_t ShardedResourceTable::Get(uint32_t id) const
+{
+	const uint32_t hash = HashResourceID(id);
+	const ShardReadScope readScope(GetShard(hash));
+	const SlotArray* pArray = readScope.GetSlots();
+
+	const size_t mask = pArray->capacity - 1;
+	size_t index = (hash >> ShardIndexBits) & mask;
+
+	// The arrays are never more than half full, so the probe always ends at
+	// the requested id or an empty slot.
+	while (pArray->slots[index].occupied.load(std::memory_order_acquire))
+	{
+		const Slot& slot = pArray->slots[index];
+
+		if (slot.id.load(std::memory_order_relaxed) == id)
+		{
+			return slot.quantity.load(std::memory_order_relaxed);
+		}
+
+		index = (index + 1) & mask;
+	}
+
+	return 0;
+}
+
+int64_t ShardedResourceTable::Add(uint32_t id, int64_t amount)
+{
+	const uint32_t hash = HashResourceID(id);
+	Shard& shard = GetShard(hash);
+
+	std::scoped_lock lock(shard.writeMutex);
+
+	Slot& slot = FindOrInsertLocked(shard, id, hash);
+	const int64_t quantity = slot.quantity.fetch_add(amount, std::memory_order_relaxed) + amount;
+
+	ReclaimRetiredSlotsLocked(shard);
+
+	return quantity;
+}
+
+void ShardedResourceTable::Set(uint32_t id, int64_t quantity)
+{
+	const uint32_t hash = HashResourceID(id);
+	Shard& shard = GetShard(hash);
+
+	std::scoped_lock lock(shard.writeMutex);
+
+	FindOrInsertLocked(shard, id, hash).quantity.store(quantity, std::memory_order_relaxed);
+
+	ReclaimRetiredSlotsLocked(shard);
+}
+
+int64_t ShardedResourceTable::StoreMax(uint32_t id, int64_t quantity)
+{
+	const uint32_t hash = HashResourceID(id);
+	Shard& shard = GetShard(hash);
+
+	std::scoped_lock lock(shard.writeMutex);
+
+	Slot& slot = FindOrInsertLocked(shard, id, hash);
+	int64_t result = slot.quantity.load(std::memory_order_relaxed);
+
+	if (quantity > result)
+	{
+		slot.quantity.store(quantity, std::memory_order_relaxed);
+		result = quantity;
+	}
+
+	ReclaimRetiredSlotsLocked(shard);
+
+	return result;
+}
+
+void ShardedResourceTable::Assign(const ResourceTable& source)
+{
+	Clear();
+
+	source.ForEach([this](uint32_t id, int64_t quantity)
+	{
+		Set(id, quantity);
+		return true;
+	});
+}
+
+void ShardedResourceTable::CopyTo(ResourceTable& destination) const
+{
+	destination.Clear();
+
+	for (const Shard& shard : shards)
+	{
+		const ShardReadScope readScope(shard);
+		const SlotArray* pArray = readScope.GetSlots();
+
+		for (size_t i = 0; i < pArray->capacity; i++)
+		{
+			const Slot& slot = pArray->slots[i];
+
+			if (slot.occupied.load(std::memory_order_acquire))
+			{
+				destination.Set(
+					slot.id.load(std::memory_order_relaxed),
+					slot.quantity.load(std::memory_order_relaxed));
+			}
+		}
+	}
+}
+
+uint32_t ShardedResourceTable::HashResourceID(uint32_t id)
+{
+	// The MurmurHash3 finalizer, the low bits select the shard and the
+	// remaining bits select the slot within the shard.
+	uint32_t hash = id;
+	hash ^= hash >> 16;
+	hash *= 0x85EBCA6BU;
+	hash ^= hash >> 13;
+	hash *= 0xC2B2AE35U;
+	hash ^= hash >> 16;
+
+	return hash;
+}
+
+ShardedResourceTable::Shard& ShardedResourceTable::GetShard(uint32_t hash)
+{
+	return shards[hash & (ShardCount - 1)];
+}
+
+const ShardedResourceTable::Shard& ShardedResourceTable::GetShard(uint32_t hash) const
+{
+	return shards[hash & (ShardCount - 1)];
+}
+
+ShardedResourceTable::Slot& ShardedResourceTable::FindOrInsertLocked(Shard& shard, uint32_t id, uint32_t hash)
+{
+	SlotArray* pArray = shard.pSlots.load(std::memory_order_relaxed);
+
+	size_t mask = pArray->capacity - 1;
+	size_t index = (hash >> ShardIndexBits) & mask;
+
+	while (pArray->slots[index].occupied.load(std::memory_order_relaxed))
+	{
+		Slot& slot = pArray->slots[index];
+
+		if (slot.id.load(std::memory_order_relaxed) == id)
+		{
+			return slot;
+		}
+
+		index = (index + 1) & mask;
+	}
+
+	const size_t count = shard.count.load(std::memory_order_relaxed);
+
+	if (((count + 1) * 2) > pArray->capacity)
+	{
+		GrowLocked(shard);
+
+		pArray = shard.pSlots.load(std::memory_order_relaxed);
+		mask = pArray->capacity - 1;
+		index = (hash >> ShardIndexBits) & mask;
+
+		while (pArray->slots[index].occupied.load(std::memory_order_relaxed))
+		{
+			index = (index + 1) & mask;
+		}
+	}
+
+	Slot& slot = pArray->slots[index];
+
+	// The occupied flag is published last so that a reader that sees
+	// it also sees the slot's id and quantity.
+	slot.id.store(id, std::memory_order_relaxed);
+	slot.quantity.store(0, std::memory_order_relaxed);
+	slot.occupied.store(1, std::memory_order_release);
+	shard.count.store(count + 1, std::memory_order_release);
+
+	return slot;
+}
+
+void ShardedResourceTable::GrowLocked(Shard& shard)
+{
+	const SlotArray* pOldArray = shard.pSlots.load(std::memory_order_relaxed);
+
+	std::unique_ptr<SlotArray> newArray = std::make_unique<SlotArray>(pOldArray->capacity * 2);
+
+	const size_t mask = newArray->capacity - 1;
+
+	for (size_t i = 0; i < pOldArray->capacity; i++)
+	{
+		const Slot& oldSlot = pOldArray->slots[i];
+
+		if (oldSlot.occupied.load(std::memory_order_relaxed))
+		{
+			const uint32_t id = oldSlot.id.load(std::memory_order_relaxed);
+			size_t index = (HashResourceID(id) >> ShardIndexBits) & mask;
+
+			while (newArray->slots[index].occupied.load(std::memory_order_relaxed))
+			{
+				index = (index + 1) & mask;
+			}
+
+			Slot& slot = newArray->slots[index];
+			slot.id.store(id, std::memory_order_relaxed);
+			slot.quantity.store(oldSlot.quantity.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			slot.occupied.store(1, std::memory_order_relaxed);
+		}
+	}
+
+	ReplaceSlotsLocked(shard, std::move(newArray));
+}
+
+void ShardedResourceTable::ReplaceSlotsLocked(Shard& shard, std::unique_ptr<SlotArray> newSlots)
+{
+	// The new array is fully initialized before it is published to the readers,
+	// the old array is retired because readers may still be probing it.
+	shard.pSlots.store(newSlots.get(), std::memory_order_seq_cst);
+	shard.retiredSlots.push_back(std::move(shard.currentSlots));
+	shard.currentSlots = std::move(newSlots);
+}
+
+void ShardedResourceTable::ReclaimRetiredSlotsLocked(Shard& shard)
+{
+	// A reader that starts after this check loads the current slot array,
+	// see ShardReadScope.
+	if (!shard.retiredSlots.empty()
+		&& shard.activeReaders.load(std::memory_order_seq_cst) == 0)
+	{
+		shard.retiredSlots.clear();
+	}
+}
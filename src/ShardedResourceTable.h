@@ -0,0 +1,133 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include "ResourceTable.h"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// A thread-safe resource id to quantity table.
+//
+// The resources are split across a fixed number of shards, each of which is an
+// open-addressing hash table of atomic slots. Writers lock the shard that owns the
+// resource id, readers never take a lock.
+// When a shard grows or is cleared its old slot array is retired instead of freed,
+// so a reader that is still probing the old array sees valid (possibly stale) values.
+// Each shard counts the readers that are probing it, the next write to the shard
+// that finds no active readers frees the retired arrays.
+class ShardedResourceTable
+{
+public:
+	ShardedResourceTable();
+
+	ShardedResourceTable(const ShardedResourceTable&) = delete;
+	ShardedResourceTable& operator=(const ShardedResourceTable&) = delete;
+
+	bool IsEmpty() const;
+	size_t GetCount() const;
+
+	void Clear();
+
+	int64_t Get(uint32_t id) const;
+
+	// Adds the specified amount to the resource quantity and returns the new quantity.
+	int64_t Add(uint32_t id, int64_t amount);
+
+	void Set(uint32_t id, int64_t quantity);
+
+	// Sets the resource quantity to the larger of its current quantity and the specified
+	// quantity, and returns the new quantity. The comparison and store happen under the
+	// shard's write lock, so concurrent callers cannot replace a larger value with a smaller one.
+	int64_t StoreMax(uint32_t id, int64_t quantity);
+
+	// Replaces the table contents with the contents of the source table.
+	void Assign(const ResourceTable& source);
+
+	// Copies the current quantities into the destination table.
+	// Each quantity is read atomically, but the copy is not an atomic snapshot
+	// of the whole table if other threads are writing to it.
+	void CopyTo(ResourceTable& destination) const;
+
+	static constexpr size_t ShardCount = 16;
+
+private:
+	struct Slot
+	{
+		std::atomic<uint32_t> id;
+		std::atomic<uint32_t> occupied;
+		std::atomic<int64_t> quantity;
+	};
+
+	struct SlotArray
+	{
+		explicit SlotArray(size_t capacity);
+
+		const size_t capacity;
+		const std::unique_ptr<Slot[]> slots;
+	};
+
+	struct alignas(64) Shard
+	{
+		Shard();
+
+		std::mutex writeMutex;
+		std::atomic<SlotArray*> pSlots;
+		std::atomic<size_t> count;
+		mutable std::atomic<uint32_t> activeReaders;
+		std::unique_ptr<SlotArray> currentSlots;
+		// The slot arrays that were replaced while readers may still be probing them.
+		std::vector<std::unique_ptr<SlotArray>> retiredSlots;
+	};
+
+	class ShardReadScope
+	{
+	public:
+		explicit ShardReadScope(const Shard& shard);
+		~ShardReadScope();
+
+		ShardReadScope(const ShardReadScope&) = delete;
+		ShardReadScope& operator=(const ShardReadScope&) = delete;
+
+		const SlotArray* GetSlots() const;
+
+	private:
+		const Shard& shard;
+	};
+
+	static uint32_t HashResourceID(uint32_t id);
+
+	Shard& GetShard(uint32_t hash);
+	const Shard& GetShard(uint32_t hash) const;
+
+	// Finds or inserts the slot for the specified id, the caller must hold the shard's write lock.
+	static Slot& FindOrInsertLocked(Shard& shard, uint32_t id, uint32_t hash);
+	static void GrowLocked(Shard& shard);
+	// Replaces the shard's slot array, the caller must hold the shard's write lock.
+	static void ReplaceSlotsLocked(Shard& shard, std::unique_ptr<SlotArray> newSlots);
+	// Frees the retired slot arrays if no reader is probing the shard,
+	// the caller must hold the shard's write lock.
+	static void ReclaimRetiredSlotsLocked(Shard& shard);
+
+	std::array<Shard, ShardCount> shards;
+};
@@ -0,0 +1,188 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ResourceTable.h"
+#include <benchmark/benchmark.h>
+#include <map>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+// Compares ResourceTable with the std::unordered_map that the resource manager used before
+// and with std::map. The argument is the number of resources in the region.
+
+namespace
+{
+	std::vector<uint32_t> CreateResourceIDs(size_t count)
+	{
+		std::mt19937 random(static_cast<uint32_t>(count));
+		std::vector<uint32_t> ids;
+		ids.reserve(count);
+
+		for (size_t i = 0; i < count; i++)
+		{
+			ids.push_back(random());
+		}
+
+		return ids;
+	}
+
+	template <typename TTable> int64_t GetQuantity(const TTable& table, uint32_t id)
+	{
+		const auto it = table.find(id);
+
+		return it != table.end() ? it->second : 0;
+	}
+
+	int64_t GetQuantity(const ResourceTable& table, uint32_t id)
+	{
+		return table.Get(id);
+	}
+
+	template <typename TTable> void AddQuantity(TTable& table, uint32_t id, int64_t amount)
+	{
+		table[id] += amount;
+	}
+
+	void AddQuantity(ResourceTable& table, uint32_t id, int64_t amount)
+	{
+		table.Add(id, amount);
+	}
+
+	template <typename TTable> void BM_Get(benchmark::State& state)
+	{
+		const std::vector<uint32_t> ids = CreateResourceIDs(static_cast<size_t>(state.range(0)));
+		TTable table;
+
+		for (uint32_t id : ids)
+		{
+			AddQuantity(table, id, 1);
+		}
+
+		size_t index = 0;
+
+		for (auto _ : state)
+		{
+			benchmark::DoNotOptimize(GetQuantity(table, ids[index]));
+
+			if (++index == ids.size())
+			{
+				index = 0;
+			}
+		}
+
+		state.SetItemsProcessed(state.iterations());
+	}
+
+	template <typename TTable> void BM_GetMissing(benchmark::State& state)
+	{
+		const std::vector<uint32_t> ids = CreateResourceIDs(static_cast<size_t>(state.range(0)));
+		TTable table;
+
+		// The table only contains even ids and the lookups use odd ids.
+		for (uint32_t id : ids)
+		{
+			AddQuantity(table, id & ~1U, 1);
+		}
+
+		size_t index = 0;
+
+		for (auto _ : state)
+		{
+			benchmark::DoNotOptimize(GetQuantity(table, ids[index] | 1U));
+
+			if (++index == ids.size())
+			{
+				index = 0;
+			}
+		}
+
+		state.SetItemsProcessed(state.iterations());
+	}
+
+	template <typename TTable> void BM_Add(benchmark::State& state)
+	{
+		const std::vector<uint32_t> ids = CreateResourceIDs(static_cast<size_t>(state.range(0)));
+		TTable table;
+
+		for (uint32_t id : ids)
+		{
+			AddQuantity(table, id, 1);
+		}
+
+		size_t index = 0;
+
+		for (auto _ : state)
+		{
+			AddQuantity(table, ids[index], 1);
+
+			if (++index == ids.size())
+			{
+				index = 0;
+			}
+		}
+
+		benchmark::DoNotOptimize(table);
+		state.SetItemsProcessed(state.iterations());
+	}
+
+	// Builds a table from nothing, which includes the small table inserts and the promotion.
+	template <typename TTable> void BM_Build(benchmark::State& state)
+	{
+		const std::vector<uint32_t> ids = CreateResourceIDs(static_cast<size_t>(state.range(0)));
+
+		for (auto _ : state)
+		{
+			TTable table;
+
+			for (uint32_t id : ids)
+			{
+				AddQuantity(table, id, 1);
+			}
+
+			benchmark::DoNotOptimize(table);
+		}
+
+		state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(ids.size()));
+	}
+
+	// The resource counts on both sides of the small table limit.
+	void ResourceCounts(benchmark::internal::Benchmark* pBenchmark)
+	{
+		for (int64_t count : { 4, 16, 32, 33, 64, 256, 1024, 4096 })
+		{
+			pBenchmark->Arg(count);
+		}
+	}
+
+	using StdMap = std::map<uint32_t, int64_t>;
+	using StdUnorderedMap = std::unordered_map<uint32_t, int64_t>;
+}
+
+#define REGISTER_RESOURCE_TABLE_BENCHMARK(function) \
+	BENCHMARK_TEMPLATE(function, ResourceTable)->Apply(ResourceCounts); \
+	BENCHMARK_TEMPLATE(function, StdUnorderedMap)->Apply(ResourceCounts); \
+	BENCHMARK_TEMPLATE(function, StdMap)->Apply(ResourceCounts)
+
+REGISTER_RESOURCE_TABLE_BENCHMARK(BM_Get);
+REGISTER_RESOURCE_TABLE_BENCHMARK(BM_GetMissing);
+REGISTER_RESOURCE_TABLE_BENCHMARK(BM_Add);
+REGISTER_RESOURCE_TABLE_BENCHMARK(BM_Build);
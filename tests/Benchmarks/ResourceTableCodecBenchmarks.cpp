@@ -0,0 +1,106 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Crc32C.h"
+#include "ResourceTableCodec.h"
+#include <benchmark/benchmark.h>
+#include <random>
+#include <vector>
+
+// Measures the throughput of the region resource record encoding.
+// The argument is the number of resources in the region.
+
+namespace
+{
+	ResourceTable CreateResourceTable(size_t count)
+	{
+		std::mt19937 random(static_cast<uint32_t>(count));
+		std::uniform_int_distribution<int64_t> quantities(-100000, 100000);
+		ResourceTable table;
+
+		while (table.GetCount() < count)
+		{
+			table.Set(random(), quantities(random));
+		}
+
+		return table;
+	}
+
+	void BM_Decode(benchmark::State& state)
+	{
+		const ResourceTable table = CreateResourceTable(static_cast<size_t>(state.range(0)));
+		std::vector<uint8_t> data;
+		ResourceTableCodec::Encode(table, data);
+
+		ResourceTable decoded;
+
+		for (auto _ : state)
+		{
+			decoded.Clear();
+
+			if (!ResourceTableCodec::Decode(data.data(), data.size(), decoded))
+			{
+				state.SkipWithError("The encoded table could not be decoded.");
+				break;
+			}
+
+			benchmark::DoNotOptimize(decoded);
+		}
+
+		state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(data.size()));
+		state.counters["record_bytes"] = static_cast<double>(data.size());
+	}
+
+	void BM_Encode(benchmark::State& state)
+	{
+		const ResourceTable table = CreateResourceTable(static_cast<size_t>(state.range(0)));
+		std::vector<uint8_t> data;
+
+		for (auto _ : state)
+		{
+			ResourceTableCodec::Encode(table, data);
+			benchmark::DoNotOptimize(data.data());
+		}
+
+		state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(data.size()));
+	}
+
+	void BM_Crc32C(benchmark::State& state)
+	{
+		std::vector<uint8_t> data(static_cast<size_t>(state.range(0)));
+
+		for (size_t i = 0; i < data.size(); i++)
+		{
+			data[i] = static_cast<uint8_t>(i * 131);
+		}
+
+		for (auto _ : state)
+		{
+			benchmark::DoNotOptimize(Crc32C::Compute(data.data(), data.size()));
+		}
+
+		state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(data.size()));
+	}
+}
+
+BENCHMARK(BM_Decode)->Arg(8)->Arg(32)->Arg(1024)->Arg(65536);
+BENCHMARK(BM_Encode)->Arg(8)->Arg(32)->Arg(1024)->Arg(65536);
+BENCHMARK(BM_Crc32C)->Arg(64)->Arg(4096)->Arg(1 << 20);
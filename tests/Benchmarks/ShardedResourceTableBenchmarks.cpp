@@ -0,0 +1,173 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ShardedResourceTable.h"
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <mutex>
+#include <random>
+#include <vector>
+
+// Measures how the region totals scale with the number of writer threads.
+// ShardedResourceTable is compared with a ResourceTable behind a single mutex.
+// The argument is the number of resources in the region.
+
+namespace
+{
+	class LockedResourceTable
+	{
+	public:
+		int64_t Get(uint32_t id) const
+		{
+			std::scoped_lock lock(mutex);
+
+			return table.Get(id);
+		}
+
+		int64_t Add(uint32_t id, int64_t amount)
+		{
+			std::scoped_lock lock(mutex);
+
+			return table.Add(id, amount);
+		}
+
+		void Clear()
+		{
+			std::scoped_lock lock(mutex);
+
+			table.Clear();
+		}
+
+	private:
+		mutable std::mutex mutex;
+		ResourceTable table;
+	};
+
+	std::vector<uint32_t> CreateResourceIDs(size_t count, uint32_t seed)
+	{
+		std::mt19937 random(seed);
+		std::vector<uint32_t> ids;
+		ids.reserve(count);
+
+		for (size_t i = 0; i < count; i++)
+		{
+			ids.push_back(random());
+		}
+
+		return ids;
+	}
+
+	template <typename TTable> TTable& GetSharedTable()
+	{
+		static TTable table;
+
+		return table;
+	}
+
+	// Every thread adds to the same resources, in a different order.
+	template <typename TTable> void BM_ConcurrentAdd(benchmark::State& state)
+	{
+		const size_t resourceCount = static_cast<size_t>(state.range(0));
+		const std::vector<uint32_t> ids = CreateResourceIDs(resourceCount, static_cast<uint32_t>(resourceCount));
+
+		std::vector<size_t> order(ids.size());
+		std::mt19937 random(static_cast<uint32_t>(state.thread_index()));
+
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			order[i] = i;
+		}
+
+		std::shuffle(order.begin(), order.end(), random);
+
+		TTable& table = GetSharedTable<TTable>();
+
+		if (state.thread_index() == 0)
+		{
+			table.Clear();
+
+			for (uint32_t id : ids)
+			{
+				table.Add(id, 0);
+			}
+		}
+
+		size_t index = 0;
+
+		for (auto _ : state)
+		{
+			benchmark::DoNotOptimize(table.Add(ids[order[index]], 1));
+
+			if (++index == order.size())
+			{
+				index = 0;
+			}
+		}
+
+		state.SetItemsProcessed(state.iterations());
+	}
+
+	// One thread adds while the other threads read, as the Lua functions
+	// do while a city is loading.
+	template <typename TTable> void BM_ReadWhileWriting(benchmark::State& state)
+	{
+		const size_t resourceCount = static_cast<size_t>(state.range(0));
+		const std::vector<uint32_t> ids = CreateResourceIDs(resourceCount, static_cast<uint32_t>(resourceCount));
+
+		TTable& table = GetSharedTable<TTable>();
+
+		if (state.thread_index() == 0)
+		{
+			table.Clear();
+
+			for (uint32_t id : ids)
+			{
+				table.Add(id, 0);
+			}
+		}
+
+		size_t index = static_cast<size_t>(state.thread_index()) % ids.size();
+
+		for (auto _ : state)
+		{
+			if (state.thread_index() == 0)
+			{
+				benchmark::DoNotOptimize(table.Add(ids[index], 1));
+			}
+			else
+			{
+				benchmark::DoNotOptimize(table.Get(ids[index]));
+			}
+
+			if (++index == ids.size())
+			{
+				index = 0;
+			}
+		}
+
+		state.SetItemsProcessed(state.iterations());
+	}
+}
+
+BENCHMARK_TEMPLATE(BM_ConcurrentAdd, ShardedResourceTable)->Arg(64)->Arg(1024)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ConcurrentAdd, LockedResourceTable)->Arg(64)->Arg(1024)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ReadWhileWriting, ShardedResourceTable)->Arg(64)->ThreadRange(2, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ReadWhileWriting, LockedResourceTable)->Arg(64)->ThreadRange(2, 8)->UseRealTime();
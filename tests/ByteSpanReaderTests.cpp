@@ -0,0 +1,101 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ByteSpanReader.h"
+#include <gtest/gtest.h>
+#include <array>
+
+TEST(ByteSpanReaderTests, ReadsLittleEndianFields)
+{
+	const std::array<uint8_t, 12> data =
+	{
+		0x78, 0x56, 0x34, 0x12,
+		0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	};
+
+	ByteSpanReader reader(data);
+
+	uint32_t value32 = 0;
+	ASSERT_TRUE(reader.GetFieldUint32(value32));
+	EXPECT_EQ(value32, 0x12345678U);
+
+	int64_t value64 = 0;
+	ASSERT_TRUE(reader.GetFieldSint64(value64));
+	EXPECT_EQ(value64, -2);
+
+	EXPECT_FALSE(reader.GetFieldUint32(value32));
+}
+
+TEST(ByteSpanReaderTests, TruncatedFieldDoesNotAdvance)
+{
+	const std::array<uint8_t, 6> data = { 1, 0, 0, 0, 2, 0 };
+
+	ByteSpanReader reader(data);
+
+	int64_t value64 = 0;
+	EXPECT_FALSE(reader.GetFieldSint64(value64));
+
+	uint32_t value32 = 0;
+	ASSERT_TRUE(reader.GetFieldUint32(value32));
+	EXPECT_EQ(value32, 1U);
+
+	EXPECT_FALSE(reader.GetFieldUint32(value32));
+	EXPECT_EQ(value32, 1U);
+
+	std::span<const uint8_t> field;
+	ASSERT_TRUE(reader.GetFieldSpan(2, field));
+	EXPECT_EQ(field[0], 2);
+}
+
+TEST(ByteSpanReaderTests, SpanFieldIsAViewIntoTheData)
+{
+	const std::array<uint8_t, 8> data = { 1, 2, 3, 4, 5, 6, 7, 8 };
+
+	ByteSpanReader reader(data);
+
+	std::span<const uint8_t> field;
+	ASSERT_TRUE(reader.GetFieldSpan(3, field));
+	EXPECT_EQ(field.data(), data.data());
+
+	ASSERT_TRUE(reader.GetFieldSpan(5, field));
+	EXPECT_EQ(field.data(), data.data() + 3);
+	EXPECT_EQ(field.size(), 5U);
+
+	// An empty field is valid at the end of the data.
+	ASSERT_TRUE(reader.GetFieldSpan(0, field));
+	EXPECT_TRUE(field.empty());
+
+	EXPECT_FALSE(reader.GetFieldSpan(1, field));
+}
+
+TEST(ByteSpanReaderTests, OversizedFieldFails)
+{
+	const std::array<uint8_t, 4> data = { 1, 2, 3, 4 };
+
+	ByteSpanReader reader(data);
+
+	std::span<const uint8_t> field;
+	EXPECT_FALSE(reader.GetFieldSpan(0xFFFFFFFF, field));
+
+	uint8_t buffer[4] = {};
+	ASSERT_TRUE(reader.GetFieldVoid(buffer, sizeof(buffer)));
+	EXPECT_EQ(buffer[3], 4);
+}
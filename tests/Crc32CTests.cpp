@@ -0,0 +1,108 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Crc32C.h"
+#include <gtest/gtest.h>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	// A bit-at-a-time implementation to check the slicing-by-8 tables against.
+	uint32_t ComputeBitwise(const uint8_t* data, size_t size)
+	{
+		uint32_t crc = 0xFFFFFFFF;
+
+		for (size_t i = 0; i < size; i++)
+		{
+			crc ^= data[i];
+
+			for (int bit = 0; bit < 8; bit++)
+			{
+				crc = (crc >> 1) ^ ((crc & 1) ? 0x82F63B78 : 0);
+			}
+		}
+
+		return ~crc;
+	}
+
+	std::vector<uint8_t> CreateTestData(size_t size)
+	{
+		std::vector<uint8_t> data(size);
+
+		for (size_t i = 0; i < size; i++)
+		{
+			data[i] = static_cast<uint8_t>((i * 131) ^ (i >> 3));
+		}
+
+		return data;
+	}
+}
+
+TEST(Crc32CTests, MatchesCheckValue)
+{
+	const char* const checkInput = "123456789";
+
+	EXPECT_EQ(Crc32C::Compute(checkInput, std::strlen(checkInput)), 0xE3069283U);
+}
+
+TEST(Crc32CTests, EmptyInputIsZero)
+{
+	EXPECT_EQ(Crc32C::Compute(nullptr, 0), 0U);
+	EXPECT_EQ(Crc32C::Compute(nullptr, 0, 0x12345678), 0x12345678U);
+}
+
+TEST(Crc32CTests, MatchesBitwiseImplementation)
+{
+	const std::vector<uint8_t> data = CreateTestData(300);
+
+	// Covers every remainder after the 8 byte blocks and unaligned start addresses.
+	for (size_t offset = 0; offset < 8; offset++)
+	{
+		for (size_t size = 0; (offset + size) <= data.size(); size += 7)
+		{
+			EXPECT_EQ(Crc32C::Compute(data.data() + offset, size), ComputeBitwise(data.data() + offset, size))
+				<< "offset " << offset << ", size " << size;
+		}
+	}
+}
+
+TEST(Crc32CTests, IncrementalMatchesOneShot)
+{
+	const std::vector<uint8_t> data = CreateTestData(100);
+	const uint32_t expected = Crc32C::Compute(data.data(), data.size());
+
+	for (size_t split = 0; split <= data.size(); split++)
+	{
+		const uint32_t first = Crc32C::Compute(data.data(), split);
+
+		EXPECT_EQ(Crc32C::Compute(data.data() + split, data.size() - split, first), expected) << "split " << split;
+	}
+
+	uint32_t crc = 0;
+
+	for (uint8_t byte : data)
+	{
+		crc = Crc32C::Compute(&byte, 1, crc);
+	}
+
+	EXPECT_EQ(crc, expected);
+}
@@ -0,0 +1,251 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DBPFIndexReader.h"
+#include "DBPFTestFile.h"
+#include <gtest/gtest.h>
+
+namespace
+{
+	// The region resource data record.
+	constexpr uint32_t RegionType = 0xA82A8BEC;
+	constexpr uint32_t RegionGroup = 0x655AEDB3;
+	constexpr uint32_t RegionInstance = 1;
+
+	// The city resource ledgers record.
+	constexpr uint32_t LedgerInstance = 2;
+
+	std::vector<uint8_t> BuildRegionFile(uint32_t indexMinorVersion = 0)
+	{
+		DBPFTestFile file(indexMinorVersion);
+		file.AddRecord(RegionType, RegionGroup, RegionInstance, { 1, 2, 3, 4, 5 });
+		file.AddRecord(RegionType, RegionGroup, LedgerInstance, { 6, 7, 8 });
+
+		return file.Build();
+	}
+
+	size_t GetIndexEntrySize(const std::vector<uint8_t>& data)
+	{
+		return DBPFTestFile::ReadUint32(data, DBPFTestFile::IndexSizeOffset)
+			/ DBPFTestFile::ReadUint32(data, DBPFTestFile::IndexEntryCountOffset);
+	}
+}
+
+TEST(DBPFIndexReaderTests, FindsRecordsWithoutCopying)
+{
+	const std::vector<uint8_t> data = BuildRegionFile();
+
+	DBPFIndexReader reader;
+	ASSERT_TRUE(reader.Open(data));
+
+	std::span<const uint8_t> record;
+	ASSERT_TRUE(reader.FindRecord(RegionType, RegionGroup, RegionInstance, record));
+	EXPECT_EQ(std::vector<uint8_t>(record.begin(), record.end()), std::vector<uint8_t>({ 1, 2, 3, 4, 5 }));
+
+	// The record is a view into the file data.
+	EXPECT_GE(record.data(), data.data());
+	EXPECT_LE(record.data() + record.size(), data.data() + data.size());
+
+	ASSERT_TRUE(reader.FindRecord(RegionType, RegionGroup, LedgerInstance, record));
+	EXPECT_EQ(record.size(), 3U);
+}
+
+TEST(DBPFIndexReaderTests, ReadsIndexVersion71)
+{
+	const std::vector<uint8_t> data = BuildRegionFile(2);
+
+	DBPFIndexReader reader;
+	ASSERT_TRUE(reader.Open(data));
+
+	std::span<const uint8_t> record;
+	ASSERT_TRUE(reader.FindRecord(RegionType, RegionGroup, LedgerInstance, record));
+	EXPECT_EQ(std::vector<uint8_t>(record.begin(), record.end()), std::vector<uint8_t>({ 6, 7, 8 }));
+}
+
+TEST(DBPFIndexReaderTests, MissingRecordIsNotFound)
+{
+	const std::vector<uint8_t> data = BuildRegionFile();
+
+	DBPFIndexReader reader;
+	ASSERT_TRUE(reader.Open(data));
+
+	std::span<const uint8_t> record;
+	EXPECT_FALSE(reader.FindRecord(RegionType, RegionGroup, 3, record));
+	EXPECT_FALSE(reader.FindRecord(RegionType, 0, RegionInstance, record));
+}
+
+TEST(DBPFIndexReaderTests, EmptyIndexHasNoRecords)
+{
+	const std::vector<uint8_t> data = DBPFTestFile().Build();
+
+	DBPFIndexReader reader;
+	ASSERT_TRUE(reader.Open(data));
+
+	std::span<const uint8_t> record;
+	EXPECT_FALSE(reader.FindRecord(RegionType, RegionGroup, RegionInstance, record));
+	EXPECT_FALSE(reader.IsCompressed(RegionType, RegionGroup, RegionInstance));
+}
+
+TEST(DBPFIndexReaderTests, RejectsDataThatIsNotADBPFFile)
+{
+	DBPFIndexReader reader;
+
+	EXPECT_FALSE(reader.Open({}));
+
+	std::vector<uint8_t> data = BuildRegionFile();
+	data[0] = 'X';
+	EXPECT_FALSE(reader.Open(data));
+}
+
+TEST(DBPFIndexReaderTests, RejectsUnsupportedVersions)
+{
+	DBPFIndexReader reader;
+
+	std::vector<uint8_t> data = BuildRegionFile();
+	DBPFTestFile::WriteUint32(data, 4, 2);
+	EXPECT_FALSE(reader.Open(data));
+
+	data = BuildRegionFile();
+	DBPFTestFile::WriteUint32(data, DBPFTestFile::IndexMajorVersionOffset, 0);
+	EXPECT_FALSE(reader.Open(data));
+}
+
+TEST(DBPFIndexReaderTests, RejectsTruncatedFiles)
+{
+	const std::vector<uint8_t> data = BuildRegionFile();
+
+	DBPFIndexReader reader;
+
+	// A truncated header.
+	EXPECT_FALSE(reader.Open(std::span(data).first(95)));
+
+	// The index is at the end of the file, so every shorter length cuts it off.
+	const size_t indexOffset = DBPFTestFile::ReadUint32(data, DBPFTestFile::IndexOffsetOffset);
+
+	for (size_t size = indexOffset; size < data.size(); size++)
+	{
+		EXPECT_FALSE(reader.Open(std::span(data).first(size))) << "size: " << size;
+	}
+}
+
+TEST(DBPFIndexReaderTests, RejectsCorruptIndexHeaders)
+{
+	const std::vector<uint8_t> original = BuildRegionFile();
+
+	DBPFIndexReader reader;
+
+	std::vector<uint8_t> data = original;
+	DBPFTestFile::WriteUint32(data, DBPFTestFile::IndexOffsetOffset, 0xFFFFFFF0);
+	EXPECT_FALSE(reader.Open(data));
+
+	data = original;
+	DBPFTestFile::WriteUint32(data, DBPFTestFile::IndexSizeOffset, 0xFFFFFFF0);
+	EXPECT_FALSE(reader.Open(data));
+
+	// More entries than the index size can hold.
+	data = original;
+	DBPFTestFile::WriteUint32(data, DBPFTestFile::IndexEntryCountOffset, 3);
+	EXPECT_FALSE(reader.Open(data));
+
+	data = original;
+	DBPFTestFile::WriteUint32(data, DBPFTestFile::IndexEntryCountOffset, 0x80000000);
+	EXPECT_FALSE(reader.Open(data));
+}
+
+TEST(DBPFIndexReaderTests, RejectsIndexEntriesOutsideTheFile)
+{
+	const std::vector<uint8_t> original = BuildRegionFile();
+	const size_t indexOffset = DBPFTestFile::ReadUint32(original, DBPFTestFile::IndexOffsetOffset);
+	const size_t entrySize = GetIndexEntrySize(original);
+
+	// The location and size are the last two fields of the second entry.
+	const size_t locationOffset = indexOffset + (2 * entrySize) - 8;
+
+	DBPFIndexReader reader;
+
+	std::vector<uint8_t> data = original;
+	DBPFTestFile::WriteUint32(data, locationOffset, static_cast<uint32_t>(data.size()) + 1);
+	EXPECT_FALSE(reader.Open(data));
+
+	data = original;
+	DBPFTestFile::WriteUint32(data, locationOffset + 4, static_cast<uint32_t>(data.size()));
+	EXPECT_FALSE(reader.Open(data));
+
+	// The offset plus the size overflows 32 bits.
+	data = original;
+	DBPFTestFile::WriteUint32(data, locationOffset + 4, 0xFFFFFFFF);
+	EXPECT_FALSE(reader.Open(data));
+}
+
+TEST(DBPFIndexReaderTests, FailedOpenClearsThePreviousFile)
+{
+	const std::vector<uint8_t> data = BuildRegionFile();
+
+	DBPFIndexReader reader;
+	ASSERT_TRUE(reader.Open(data));
+	ASSERT_FALSE(reader.Open(std::span(data).first(10)));
+
+	std::span<const uint8_t> record;
+	EXPECT_FALSE(reader.FindRecord(RegionType, RegionGroup, RegionInstance, record));
+}
+
+TEST(DBPFIndexReaderTests, ReportsCompressedRecords)
+{
+	for (uint32_t indexMinorVersion : { 0U, 2U })
+	{
+		DBPFTestFile file(indexMinorVersion);
+		file.AddRecord(RegionType, RegionGroup, RegionInstance, { 0x10, 0xFB, 0, 0, 5 }, true);
+		file.AddRecord(RegionType, RegionGroup, LedgerInstance, { 6, 7, 8 });
+
+		const std::vector<uint8_t> data = file.Build();
+
+		DBPFIndexReader reader;
+		ASSERT_TRUE(reader.Open(data));
+
+		EXPECT_TRUE(reader.IsCompressed(RegionType, RegionGroup, RegionInstance));
+		EXPECT_FALSE(reader.IsCompressed(RegionType, RegionGroup, LedgerInstance));
+
+		// The compressed data is returned as is, the caller falls back to the packed file segment.
+		std::span<const uint8_t> record;
+		ASSERT_TRUE(reader.FindRecord(RegionType, RegionGroup, RegionInstance, record));
+		EXPECT_EQ(record.size(), 5U);
+	}
+}
+
+TEST(DBPFIndexReaderTests, IgnoresPartialCompressionDirectoryEntries)
+{
+	DBPFTestFile file;
+	file.AddRecord(RegionType, RegionGroup, LedgerInstance, { 6, 7, 8 }, true);
+
+	std::vector<uint8_t> data = file.Build();
+
+	// Shrink the directory record, which is the last record before the index,
+	// so that its only entry is incomplete.
+	const size_t indexOffset = DBPFTestFile::ReadUint32(data, DBPFTestFile::IndexOffsetOffset);
+	const size_t entrySize = GetIndexEntrySize(data);
+	const size_t directorySizeOffset = indexOffset + (2 * entrySize) - 4;
+
+	DBPFTestFile::WriteUint32(data, directorySizeOffset, DBPFTestFile::ReadUint32(data, directorySizeOffset) - 1);
+
+	DBPFIndexReader reader;
+	ASSERT_TRUE(reader.Open(data));
+	EXPECT_FALSE(reader.IsCompressed(RegionType, RegionGroup, LedgerInstance));
+}
@@ -0,0 +1,164 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DBPFTestFile.h"
+#include <atomic>
+#include <fstream>
+#include <random>
+#include <string>
+
+namespace
+{
+	constexpr uint32_t DirectoryType = 0xE86B1EEF;
+	constexpr uint32_t DirectoryGroup = 0xE86B1EEF;
+	constexpr uint32_t DirectoryInstance = 0x286B1F03;
+
+	constexpr size_t HeaderSize = 96;
+
+	void AppendUint32(std::vector<uint8_t>& data, uint32_t value)
+	{
+		data.push_back(static_cast<uint8_t>(value));
+		data.push_back(static_cast<uint8_t>(value >> 8));
+		data.push_back(static_cast<uint8_t>(value >> 16));
+		data.push_back(static_cast<uint8_t>(value >> 24));
+	}
+}
+
+DBPFTestFile::DBPFTestFile(uint32_t indexMinorVersion)
+	: indexMinorVersion(indexMinorVersion),
+	  records()
+{
+}
+
+void DBPFTestFile::AddRecord(uint32_t type, uint32_t group, uint32_t instance, std::vector<uint8_t> data, bool compressed)
+{
+	records.emplace_back(type, group, instance, std::move(data), compressed);
+}
+
+std::vector<uint8_t> DBPFTestFile::Build() const
+{
+	const bool hasSecondInstance = indexMinorVersion >= 2;
+
+	std::vector<Record> fileRecords = records;
+	std::vector<uint8_t> directory;
+
+	for (const Record& record : records)
+	{
+		if (record.compressed)
+		{
+			AppendUint32(directory, record.type);
+			AppendUint32(directory, record.group);
+			AppendUint32(directory, record.instance);
+
+			if (hasSecondInstance)
+			{
+				AppendUint32(directory, 0);
+			}
+
+			AppendUint32(directory, static_cast<uint32_t>(record.data.size()));
+		}
+	}
+
+	if (!directory.empty())
+	{
+		fileRecords.emplace_back(DirectoryType, DirectoryGroup, DirectoryInstance, std::move(directory), false);
+	}
+
+	std::vector<uint8_t> file(HeaderSize);
+	file[0] = 'D';
+	file[1] = 'B';
+	file[2] = 'P';
+	file[3] = 'F';
+	WriteUint32(file, 4, 1); // Major version
+
+	std::vector<uint8_t> index;
+
+	for (const Record& record : fileRecords)
+	{
+		AppendUint32(index, record.type);
+		AppendUint32(index, record.group);
+		AppendUint32(index, record.instance);
+
+		if (hasSecondInstance)
+		{
+			AppendUint32(index, 0);
+		}
+
+		AppendUint32(index, static_cast<uint32_t>(file.size()));
+		AppendUint32(index, static_cast<uint32_t>(record.data.size()));
+
+		file.insert(file.end(), record.data.begin(), record.data.end());
+	}
+
+	WriteUint32(file, IndexMajorVersionOffset, 7);
+	WriteUint32(file, IndexEntryCountOffset, static_cast<uint32_t>(fileRecords.size()));
+	WriteUint32(file, IndexOffsetOffset, static_cast<uint32_t>(file.size()));
+	WriteUint32(file, IndexSizeOffset, static_cast<uint32_t>(index.size()));
+	WriteUint32(file, 0x3C, indexMinorVersion);
+
+	file.insert(file.end(), index.begin(), index.end());
+
+	return file;
+}
+
+uint32_t DBPFTestFile::ReadUint32(std::span<const uint8_t> data, size_t offset)
+{
+	return static_cast<uint32_t>(data[offset])
+		| (static_cast<uint32_t>(data[offset + 1]) << 8)
+		| (static_cast<uint32_t>(data[offset + 2]) << 16)
+		| (static_cast<uint32_t>(data[offset + 3]) << 24);
+}
+
+void DBPFTestFile::WriteUint32(std::vector<uint8_t>& data, size_t offset, uint32_t value)
+{
+	data[offset] = static_cast<uint8_t>(value);
+	data[offset + 1] = static_cast<uint8_t>(value >> 8);
+	data[offset + 2] = static_cast<uint8_t>(value >> 16);
+	data[offset + 3] = static_cast<uint8_t>(value >> 24);
+}
+
+TemporaryFile::TemporaryFile(std::span<const uint8_t> data)
+{
+	// ctest runs each test in its own process, the random prefix keeps the names unique across them.
+	static const uint32_t processPrefix = std::random_device()();
+	static std::atomic<uint32_t> fileNumber = 0;
+
+	path = std::filesystem::temp_directory_path() / (
+		"RegionalSupplyTest"
+		+ std::to_string(processPrefix)
+		+ "_"
+		+ std::to_string(fileNumber.fetch_add(1))
+		+ ".dat");
+
+	std::ofstream file(path, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+	file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+}
+
+TemporaryFile::~TemporaryFile()
+{
+	std::error_code ec;
+	std::filesystem::remove(path, ec);
+}
+
+const std::filesystem::path& TemporaryFile::GetPath() const
+{
+	return path;
+}
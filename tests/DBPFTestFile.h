@@ -0,0 +1,78 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+// Builds DBPF 1.x files for the data file reader tests.
+class DBPFTestFile
+{
+public:
+	struct Record
+	{
+		uint32_t type;
+		uint32_t group;
+		uint32_t instance;
+		std::vector<uint8_t> data;
+		// Adds the record to the compression directory.
+		bool compressed;
+	};
+
+	// indexMinorVersion 2 selects the index 7.1 format, which adds a second instance id to the entries.
+	explicit DBPFTestFile(uint32_t indexMinorVersion = 0);
+
+	void AddRecord(uint32_t type, uint32_t group, uint32_t instance, std::vector<uint8_t> data, bool compressed = false);
+
+	// Returns the file data, the index follows the records.
+	std::vector<uint8_t> Build() const;
+
+	// The offsets of the index header fields.
+	static constexpr size_t IndexMajorVersionOffset = 0x20;
+	static constexpr size_t IndexEntryCountOffset = 0x24;
+	static constexpr size_t IndexOffsetOffset = 0x28;
+	static constexpr size_t IndexSizeOffset = 0x2C;
+
+	static uint32_t ReadUint32(std::span<const uint8_t> data, size_t offset);
+	static void WriteUint32(std::vector<uint8_t>& data, size_t offset, uint32_t value);
+
+private:
+	uint32_t indexMinorVersion;
+	std::vector<Record> records;
+};
+
+// Writes the data to a file in the temporary directory, the file is deleted by the destructor.
+class TemporaryFile
+{
+public:
+	explicit TemporaryFile(std::span<const uint8_t> data);
+	~TemporaryFile();
+
+	TemporaryFile(const TemporaryFile&) = delete;
+	TemporaryFile& operator=(const TemporaryFile&) = delete;
+
+	const std::filesystem::path& GetPath() const;
+
+private:
+	std::filesystem::path path;
+};
@@ -0,0 +1,308 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// A headless Lua host for the regional_supply functions.
+//
+// The host creates its own resource manager and a stock Lua state, loads the
+// stub functions from dat/regional_supply.lua and replaces them with the plugin's
+// functions in the same way as the game. It then runs the Lua test script and, if
+// --benchmark is specified, measures the latency of each function.
+//
+// The game's cIGZLua5Thread wraps a Lua 5.0 interpreter, the host is built with Lua 5.1.
+// Both versions store every number as a double and neither lua_getglobal nor
+// lua_rawgeti returns a value, so the plugin's functions see the same argument
+// types and stack layout. A passing run does not show that the game behaves the same:
+// - The host calls the Lua C API directly, the game's cIGZLua5Thread methods may
+//   check or convert the arguments differently.
+// - Lua 5.0 does not have the # operator, varargs in the main chunk or integer
+//   pushes, the test script avoids them but the benchmark chunks use varargs.
+// - Lua 5.2 and later are not recommended, they add an integer number subtype and
+//   lua_getglobal returns the value type.
+// The in-game self-test in the DLL director runs the read functions through the game's interpreter.
+//
+//   RegionalSupplyLuaHost <regional_supply.lua> <regional_supply_tests.lua> [--benchmark]
+
+#include "GlobalPointers.h"
+#include "RegionalSupplyLua.h"
+#include "RegionalSupplyManager.h"
+#include "SCLuaUtil.h"
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+
+IRegionalSupplyManager2* spRegionalSupplyManager = nullptr;
+ResourceWatchList* spResourceWatchList = nullptr;
+
+namespace
+{
+	// The adapter of each Lua state and thread that has called a plugin function.
+	// A coroutine has its own stack, so it cannot use the adapter of the main state.
+	std::unordered_map<lua_State*, std::unique_ptr<cISCLua>> luaAdapters;
+
+	RegionalSupplyManager* pManager = nullptr;
+
+	constexpr uint32_t BenchmarkIterations = 1000000;
+
+	struct Benchmark
+	{
+		const char* functionName;
+		const char* arguments;
+	};
+
+	// The arguments are Lua expressions, the benchmark chunk defines id, ids and deltas.
+	constexpr std::array<Benchmark, 9> Benchmarks =
+	{
+		Benchmark{ "add_to_demand", "id, 1" },
+		Benchmark{ "remove_from_demand", "id, 1" },
+		Benchmark{ "add_to_supply", "id, 1" },
+		Benchmark{ "remove_from_supply", "id, 1" },
+		Benchmark{ "get_resource_quantity", "id" },
+		Benchmark{ "get_generation", "id" },
+		Benchmark{ "get_resource_quantities", "ids" },
+		Benchmark{ "apply_deltas", "deltas" },
+		Benchmark{ "watch", "id, 0, 1000000, 'benchmark_callback'" },
+	};
+
+	// Lets the test script run the game thread part of a simulation tick,
+	// which dispatches the pending watch events.
+	int RunTick(lua_State* pState)
+	{
+		pManager->OnTick(0);
+		return 0;
+	}
+
+	// The baseline of the benchmarks. It gets the adapter like the plugin functions,
+	// so that the host's lookup is not counted as part of the function latency.
+	int EmptyFunction(lua_State* pState)
+	{
+		cRZAutoRefCount<cISCLua> lua = SCLuaUtil::GetISCLuaFromFunctionState(pState);
+
+		return 0;
+	}
+
+	bool CheckLuaResult(lua_State* pState, int status, const char* description)
+	{
+		if (status != 0)
+		{
+			const char* message = lua_tostring(pState, -1);
+
+			std::fprintf(stderr, "%s failed: %s\n", description, message ? message : "unknown error");
+			lua_pop(pState, 1);
+			return false;
+		}
+
+		return true;
+	}
+
+	bool LoadApiScript(lua_State* pState, const char* path)
+	{
+		return CheckLuaResult(pState, luaL_dofile(pState, path), path);
+	}
+
+	// Replaces the stub functions in the regional_supply table, the game does
+	// the same when the plugin registers its functions.
+	bool RegisterFunctions(lua_State* pState)
+	{
+		lua_getglobal(pState, "regional_supply");
+
+		if (!lua_istable(pState, -1))
+		{
+			std::fprintf(stderr, "The Lua script did not create the regional_supply table.\n");
+			lua_pop(pState, 1);
+			return false;
+		}
+
+		for (const RegionalSupplyLua::Function& function : RegionalSupplyLua::GetFunctions())
+		{
+			lua_pushcfunction(pState, function.callback);
+			lua_setfield(pState, -2, function.name);
+		}
+
+		lua_pop(pState, 1);
+
+		lua_newtable(pState);
+		lua_pushcfunction(pState, RunTick);
+		lua_setfield(pState, -2, "tick");
+		lua_pushcfunction(pState, EmptyFunction);
+		lua_setfield(pState, -2, "empty_function");
+		lua_setglobal(pState, "regional_supply_host");
+
+		return true;
+	}
+
+	// The test script returns the number of failed tests.
+	bool RunTests(lua_State* pState, const char* path)
+	{
+		if (!CheckLuaResult(pState, luaL_loadfile(pState, path), path)
+			|| !CheckLuaResult(pState, lua_pcall(pState, 0, 1, 0), path))
+		{
+			return false;
+		}
+
+		const lua_Integer failures = lua_tointeger(pState, -1);
+		lua_pop(pState, 1);
+
+		return failures == 0;
+	}
+
+	// Returns the average time of a call in nanoseconds, or a negative value if the benchmark failed.
+	double MeasureFunction(lua_State* pState, const char* tableName, const char* functionName, const char* arguments)
+	{
+		char chunk[1024]{};
+
+		std::snprintf(
+			chunk,
+			sizeof(chunk),
+			"local iterations = ...\n"
+			"local f = %s.%s\n"
+			"local id = 0x42000000\n"
+			"local ids = { id, id + 1, id + 2, id + 3, id + 4, id + 5, id + 6, id + 7 }\n"
+			"local deltas = { { id, 1 }, { id + 1, -1 } }\n"
+			"for i = 1, iterations do f(%s) end\n",
+			tableName,
+			functionName,
+			arguments);
+
+		if (!CheckLuaResult(pState, luaL_loadstring(pState, chunk), functionName))
+		{
+			return -1.0;
+		}
+
+		lua_pushinteger(pState, BenchmarkIterations);
+
+		const auto start = std::chrono::steady_clock::now();
+		const int status = lua_pcall(pState, 1, 0, 0);
+		const auto end = std::chrono::steady_clock::now();
+
+		if (!CheckLuaResult(pState, status, functionName))
+		{
+			return -1.0;
+		}
+
+		const std::chrono::duration<double, std::nano> elapsed = end - start;
+
+		return elapsed.count() / BenchmarkIterations;
+	}
+
+	// Measures each function and subtracts the time of an empty C function that
+	// is called with the same arguments, the remainder is the plugin's own cost.
+	bool RunBenchmarks(lua_State* pState)
+	{
+		std::printf("%-26s %12s %12s\n", "function", "ns/call", "net ns/call");
+
+		for (const Benchmark& benchmark : Benchmarks)
+		{
+			const double baseline = MeasureFunction(pState, "regional_supply_host", "empty_function", benchmark.arguments);
+			const double total = MeasureFunction(pState, "regional_supply", benchmark.functionName, benchmark.arguments);
+
+			if (baseline < 0.0 || total < 0.0)
+			{
+				return false;
+			}
+
+			std::printf("%-26s %12.1f %12.1f\n", benchmark.functionName, total, total - baseline);
+		}
+
+		return true;
+	}
+}
+
+cRZAutoRefCount<cISCLua> SCLuaUtil::GetISCLuaFromFunctionState(lua_State* pState)
+{
+	std::unique_ptr<cISCLua>& adapter = luaAdapters[pState];
+
+	if (!adapter)
+	{
+		adapter = std::make_unique<cISCLua>(pState);
+	}
+
+	return cRZAutoRefCount<cISCLua>(adapter.get());
+}
+
+int main(int argc, char* argv[])
+{
+	const char* apiScriptPath = nullptr;
+	const char* testScriptPath = nullptr;
+	bool runBenchmarks = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--benchmark") == 0)
+		{
+			runBenchmarks = true;
+		}
+		else if (!apiScriptPath)
+		{
+			apiScriptPath = argv[i];
+		}
+		else if (!testScriptPath)
+		{
+			testScriptPath = argv[i];
+		}
+	}
+
+	if (!apiScriptPath || !testScriptPath)
+	{
+		std::fprintf(stderr, "Usage: RegionalSupplyLuaHost <regional_supply.lua> <regional_supply_tests.lua> [--benchmark]\n");
+		return 2;
+	}
+
+	// The host starts with an empty region, it does not load or save a region data file.
+	RegionalSupplyManager manager;
+	manager.LoadAsync(nullptr, std::filesystem::path());
+
+	pManager = &manager;
+	spRegionalSupplyManager = &manager;
+	spResourceWatchList = &manager.GetWatchList();
+
+	lua_State* pState = luaL_newstate();
+	luaL_openlibs(pState);
+
+	manager.SetWatchEventHandler(
+		[pState](std::span<const ResourceWatchList::Event> events)
+		{
+			cRZAutoRefCount<cISCLua> lua = SCLuaUtil::GetISCLuaFromFunctionState(pState);
+
+			RegionalSupplyLua::DispatchWatchEvents(lua, events);
+		});
+
+	bool succeeded = LoadApiScript(pState, apiScriptPath)
+		&& RegisterFunctions(pState)
+		&& RunTests(pState, testScriptPath);
+
+	if (succeeded && runBenchmarks)
+	{
+		succeeded = RunBenchmarks(pState);
+	}
+
+	manager.SetWatchEventHandler(nullptr);
+	lua_close(pState);
+	luaAdapters.clear();
+
+	spResourceWatchList = nullptr;
+	spRegionalSupplyManager = nullptr;
+	pManager = nullptr;
+
+	return succeeded ? 0 : 1;
+}
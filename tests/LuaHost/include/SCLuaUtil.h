@@ -0,0 +1,32 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include "cISCLua.h"
+#include "cRZAutoRefCount.h"
+
+// Replaces the gzcom-dll SCLuaUtil functions that the plugin's Lua functions call,
+// the Lua test host implements them.
+namespace SCLuaUtil
+{
+	// Gets the cISCLua adapter of the Lua state or thread that called the function.
+	cRZAutoRefCount<cISCLua> GetISCLuaFromFunctionState(lua_State* pState);
+}
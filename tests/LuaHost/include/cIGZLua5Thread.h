@@ -0,0 +1,152 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include "cIGZUnknown.h"
+#include <cstdint>
+#include <lua.hpp>
+
+// Replaces the gzcom-dll cIGZLua5Thread interface in the Lua test host.
+//
+// The game implements cIGZLua5Thread on top of its own Lua 5 interpreter.
+// The host implements the methods that the plugin's Lua functions call on top
+// of a stock Lua 5.1 state, the method names and argument order match the
+// gzcom-dll declarations so that the plugin sources compile unchanged.
+// The object does not own the Lua state and it is not reference counted.
+class cIGZLua5Thread : public cIGZUnknown
+{
+public:
+	enum LuaType : int32_t
+	{
+		LuaTypeNone = LUA_TNONE,
+		LuaTypeNil = LUA_TNIL,
+		LuaTypeBoolean = LUA_TBOOLEAN,
+		LuaTypeLightUserData = LUA_TLIGHTUSERDATA,
+		LuaTypeNumber = LUA_TNUMBER,
+		LuaTypeString = LUA_TSTRING,
+		LuaTypeTable = LUA_TTABLE,
+		LuaTypeFunction = LUA_TFUNCTION,
+		LuaTypeUserData = LUA_TUSERDATA,
+		LuaTypeThread = LUA_TTHREAD,
+	};
+
+	explicit cIGZLua5Thread(lua_State* pState)
+		: pState(pState)
+	{
+	}
+
+	virtual ~cIGZLua5Thread()
+	{
+	}
+
+	bool QueryInterface(uint32_t riid, void** ppvObj) override
+	{
+		return false;
+	}
+
+	uint32_t AddRef() override
+	{
+		return 1;
+	}
+
+	uint32_t Release() override
+	{
+		return 1;
+	}
+
+	lua_State* GetState() const
+	{
+		return pState;
+	}
+
+	int32_t GetTop()
+	{
+		return lua_gettop(pState);
+	}
+
+	void SetTop(int32_t index)
+	{
+		lua_settop(pState, index);
+	}
+
+	int32_t Type(int32_t index)
+	{
+		return lua_type(pState, index);
+	}
+
+	bool IsFunction(int32_t index)
+	{
+		return lua_isfunction(pState, index) != 0;
+	}
+
+	double ToNumber(int32_t index)
+	{
+		return static_cast<double>(lua_tonumber(pState, index));
+	}
+
+	const char* ToString(int32_t index)
+	{
+		return lua_tostring(pState, index);
+	}
+
+	void PushNil()
+	{
+		lua_pushnil(pState);
+	}
+
+	void PushNumber(double value)
+	{
+		lua_pushnumber(pState, static_cast<lua_Number>(value));
+	}
+
+	void PushString(const char* value)
+	{
+		lua_pushstring(pState, value);
+	}
+
+	void NewTable()
+	{
+		lua_newtable(pState);
+	}
+
+	void RawGetI(int32_t index, int32_t n)
+	{
+		lua_rawgeti(pState, index, n);
+	}
+
+	void RawSetI(int32_t index, int32_t n)
+	{
+		lua_rawseti(pState, index, n);
+	}
+
+	void GetGlobal(const char* name)
+	{
+		lua_getglobal(pState, name);
+	}
+
+	int32_t PCall(int32_t argumentCount, int32_t resultCount, int32_t errorFunction)
+	{
+		return lua_pcall(pState, argumentCount, resultCount, errorFunction);
+	}
+
+private:
+	lua_State* pState;
+};
@@ -0,0 +1,259 @@
+-- Tests the regional_supply functions against the plugin's resource manager.
+-- RegionalSupplyLuaHost runs this file after it has replaced the stub functions
+-- from dat/regional_supply.lua, the file returns the number of failed tests.
+-- The manager is shared by all tests, so each test uses its own resource ids.
+-- The file only uses the language features of the game's Lua 5.0 interpreter,
+-- e.g. it does not use the # operator or hexadecimal numbers.
+
+local failures = 0
+
+local function run_test(name, test)
+	local ok, message = pcall(test)
+
+	if ok then
+		print("[  PASSED  ] " .. name)
+	else
+		failures = failures + 1
+		print("[  FAILED  ] " .. name .. ": " .. tostring(message))
+	end
+end
+
+-- Counts the array entries up to the first nil.
+local function count_entries(t)
+	local count = 0
+
+	while t[count + 1] ~= nil do
+		count = count + 1
+	end
+
+	return count
+end
+
+local function expect_equal(actual, expected, description)
+	if actual ~= expected then
+		error(string.format("%s: expected %s, got %s", description, tostring(expected), tostring(actual)), 2)
+	end
+end
+
+-- Creates a global watch callback that records its calls.
+local function create_callback(name)
+	local calls = {}
+
+	_G[name] = function(resourceID, quantity)
+		table.insert(calls, { resourceID = resourceID, quantity = quantity })
+	end
+
+	return calls
+end
+
+local function expect_calls(calls, expected, description)
+	expect_equal(count_entries(calls), count_entries(expected), description .. " call count")
+
+	for i, call in ipairs(expected) do
+		expect_equal(calls[i].resourceID, call[1], description .. " resource id")
+		expect_equal(calls[i].quantity, call[2], description .. " quantity")
+	end
+end
+
+run_test("add_to_supply and remove_from_supply change the quantity", function()
+	local id = 1381171201
+
+	regional_supply.add_to_supply(id, 100)
+	expect_equal(regional_supply.get_resource_quantity(id), 100, "after add_to_supply")
+
+	regional_supply.remove_from_supply(id, 30)
+	expect_equal(regional_supply.get_resource_quantity(id), 70, "after remove_from_supply")
+end)
+
+run_test("add_to_demand and remove_from_demand change the quantity", function()
+	local id = 1381171202
+
+	regional_supply.add_to_demand(id, 40)
+	expect_equal(regional_supply.get_resource_quantity(id), -40, "after add_to_demand")
+
+	regional_supply.remove_from_demand(id, 15)
+	expect_equal(regional_supply.get_resource_quantity(id), -25, "after remove_from_demand")
+end)
+
+run_test("Invalid arguments are ignored", function()
+	local id = 1381171203
+	local generation = regional_supply.get_generation()
+
+	regional_supply.add_to_supply(id)
+	regional_supply.add_to_supply(id, -1)
+	regional_supply.add_to_supply(id, 4294967296)
+	regional_supply.add_to_supply(id, 0 / 0)
+	regional_supply.add_to_supply(id, "10")
+	regional_supply.add_to_supply(id, 10, 10)
+	regional_supply.add_to_demand(-1, 10)
+	regional_supply.add_to_demand({}, 10)
+
+	expect_equal(regional_supply.get_resource_quantity(id), 0, "quantity")
+	expect_equal(regional_supply.get_generation(), generation, "generation")
+	expect_equal(regional_supply.get_resource_quantity(), 0, "quantity without a resource id")
+	expect_equal(regional_supply.get_resource_quantity("id"), 0, "quantity of a string")
+	expect_equal(regional_supply.get_generation("id"), 0, "generation of a string")
+	expect_equal(regional_supply.get_generation(id, id), 0, "generation with two arguments")
+end)
+
+run_test("get_resource_quantities uses the indices of the resource ids", function()
+	local first = 1381171204
+	local second = 1381171205
+
+	regional_supply.add_to_supply(first, 5)
+	regional_supply.add_to_demand(second, 7)
+
+	local quantities = regional_supply.get_resource_quantities({ first, "invalid", second })
+	expect_equal(count_entries(quantities), 3, "result length")
+	expect_equal(quantities[1], 5, "first quantity")
+	expect_equal(quantities[2], 0, "invalid resource id quantity")
+	expect_equal(quantities[3], -7, "second quantity")
+
+	-- The resource ids end at the first nil.
+	quantities = regional_supply.get_resource_quantities({ first, nil, second })
+	expect_equal(count_entries(quantities), 1, "result length with a nil entry")
+
+	expect_equal(count_entries(regional_supply.get_resource_quantities({})), 0, "empty table result length")
+	expect_equal(regional_supply.get_resource_quantities(first), nil, "result of a number")
+	expect_equal(regional_supply.get_resource_quantities(), nil, "result without arguments")
+end)
+
+run_test("apply_deltas applies every delta", function()
+	local first = 1381171206
+	local second = 1381171207
+
+	regional_supply.apply_deltas({ { first, 10 }, { second, -4 }, { first, 5 } })
+
+	expect_equal(regional_supply.get_resource_quantity(first), 15, "first quantity")
+	expect_equal(regional_supply.get_resource_quantity(second), -4, "second quantity")
+end)
+
+run_test("apply_deltas applies a table that is larger than the stack buffer", function()
+	local base = 1381172000
+	local deltas = {}
+
+	-- Each id is added twice, the second half of the table repeats the first.
+	for i = 1, 100 do
+		deltas[i] = { base + i, i }
+		deltas[i + 100] = { base + i, 1 }
+	end
+
+	regional_supply.apply_deltas(deltas)
+
+	expect_equal(regional_supply.get_resource_quantity(base + 1), 2, "first quantity")
+	expect_equal(regional_supply.get_resource_quantity(base + 64), 65, "last stack quantity")
+	expect_equal(regional_supply.get_resource_quantity(base + 65), 66, "first heap quantity")
+	expect_equal(regional_supply.get_resource_quantity(base + 100), 101, "last quantity")
+
+	-- An invalid entry after the stack buffer is full discards the whole table.
+	local generation = regional_supply.get_generation()
+
+	deltas[150] = { base + 50, "1" }
+	regional_supply.apply_deltas(deltas)
+
+	expect_equal(regional_supply.get_resource_quantity(base + 1), 2, "quantity after an invalid table")
+	expect_equal(regional_supply.get_generation(), generation, "generation after an invalid table")
+end)
+
+run_test("apply_deltas ignores a table with an invalid entry", function()
+	local id = 1381171208
+	local generation = regional_supply.get_generation()
+
+	regional_supply.apply_deltas({ { id, 10 }, { id, "10" } })
+	regional_supply.apply_deltas({ { id, 10 }, 10 })
+	regional_supply.apply_deltas({ { id, 10 }, { id } })
+	regional_supply.apply_deltas({ { id, 10 }, { -1, 10 } })
+	regional_supply.apply_deltas({ { id, 10 } }, {})
+	regional_supply.apply_deltas({})
+	regional_supply.apply_deltas(id)
+
+	expect_equal(regional_supply.get_resource_quantity(id), 0, "quantity")
+	expect_equal(regional_supply.get_generation(), generation, "generation")
+end)
+
+run_test("get_generation changes when a resource changes", function()
+	local changed = 1381171209
+	local unchanged = 1381171210
+
+	local generation = regional_supply.get_generation()
+	local changedGeneration = regional_supply.get_generation(changed)
+	local unchangedGeneration = regional_supply.get_generation(unchanged)
+
+	regional_supply.add_to_supply(changed, 1)
+
+	expect_equal(regional_supply.get_generation() > generation, true, "region generation increased")
+	expect_equal(regional_supply.get_generation(changed) > changedGeneration, true, "resource generation increased")
+	expect_equal(regional_supply.get_generation(unchanged), unchangedGeneration, "other resource generation")
+end)
+
+run_test("watch calls the callback once per tick after a crossing", function()
+	local id = 1381171211
+	local calls = create_callback("on_crossing_test")
+
+	regional_supply.watch(id, 10, 20, "on_crossing_test")
+
+	regional_supply.add_to_supply(id, 5)
+	regional_supply_host.tick()
+	expect_calls(calls, {}, "below the thresholds")
+
+	regional_supply.add_to_supply(id, 10)
+	regional_supply_host.tick()
+	expect_calls(calls, { { id, 15 } }, "crossing the low threshold")
+
+	regional_supply_host.tick()
+	expect_calls(calls, { { id, 15 } }, "a tick without changes")
+
+	-- Both crossings happen before the tick, the callback receives the latest quantity.
+	regional_supply.add_to_supply(id, 10)
+	regional_supply.remove_from_supply(id, 6)
+	regional_supply_host.tick()
+	expect_calls(calls, { { id, 15 }, { id, 19 } }, "crossing the high threshold twice")
+end)
+
+run_test("watch replaces the thresholds of a watch with the same callback", function()
+	local id = 1381171212
+	local calls = create_callback("on_replaced_test")
+
+	regional_supply.watch(id, 10, 20, "on_replaced_test")
+	regional_supply.watch(id, 100, 200, "on_replaced_test")
+
+	regional_supply.add_to_supply(id, 15)
+	regional_supply_host.tick()
+	expect_calls(calls, {}, "crossing the replaced thresholds")
+
+	regional_supply.add_to_supply(id, 90)
+	regional_supply_host.tick()
+	expect_calls(calls, { { id, 105 } }, "crossing the new thresholds")
+end)
+
+run_test("watch ignores invalid arguments", function()
+	local id = 1381171213
+	local calls = create_callback("on_invalid_test")
+
+	regional_supply.watch(id, 20, 10, "on_invalid_test")
+	regional_supply.watch(id, 0, 10)
+	regional_supply.watch(id, 0, 10, "")
+	regional_supply.watch(id, 0, 10, 5)
+	regional_supply.watch("id", 0, 10, "on_invalid_test")
+
+	regional_supply.add_to_supply(id, 15)
+	regional_supply_host.tick()
+	expect_calls(calls, {}, "after the invalid watches")
+end)
+
+run_test("A failing callback does not stop the other callbacks", function()
+	local id = 1381171214
+	local calls = create_callback("on_other_test")
+
+	on_failing_test = function() error("callback error") end
+
+	regional_supply.watch(id, 0, 10, "on_failing_test")
+	regional_supply.watch(id, 0, 10, "on_missing_test")
+	regional_supply.watch(id, 0, 10, "on_other_test")
+
+	regional_supply.add_to_supply(id, 15)
+	regional_supply_host.tick()
+	expect_calls(calls, { { id, 15 } }, "other callback")
+end)
+
+return failures
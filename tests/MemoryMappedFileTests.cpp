@@ -0,0 +1,98 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DBPFIndexReader.h"
+#include "DBPFTestFile.h"
+#include "MemoryMappedFile.h"
+#include <gtest/gtest.h>
+
+TEST(MemoryMappedFileTests, MapsTheFileContents)
+{
+	const std::vector<uint8_t> data = { 1, 2, 3, 4, 5, 6, 7 };
+	const TemporaryFile file(data);
+
+	MemoryMappedFile mapping;
+	ASSERT_TRUE(mapping.Open(file.GetPath()));
+
+	const std::span<const uint8_t> mappedData = mapping.GetData();
+	EXPECT_EQ(std::vector<uint8_t>(mappedData.begin(), mappedData.end()), data);
+}
+
+TEST(MemoryMappedFileTests, MissingFileFails)
+{
+	MemoryMappedFile mapping;
+
+	EXPECT_FALSE(mapping.Open(std::filesystem::temp_directory_path() / "RegionalSupplyTestMissing.dat"));
+	EXPECT_TRUE(mapping.GetData().empty());
+}
+
+TEST(MemoryMappedFileTests, EmptyFileFails)
+{
+	const TemporaryFile file({});
+
+	MemoryMappedFile mapping;
+
+	EXPECT_FALSE(mapping.Open(file.GetPath()));
+	EXPECT_TRUE(mapping.GetData().empty());
+}
+
+TEST(MemoryMappedFileTests, CloseAndReopen)
+{
+	const std::vector<uint8_t> firstData = { 1, 2, 3 };
+	const std::vector<uint8_t> secondData = { 4, 5 };
+	const TemporaryFile firstFile(firstData);
+	const TemporaryFile secondFile(secondData);
+
+	MemoryMappedFile mapping;
+	ASSERT_TRUE(mapping.Open(firstFile.GetPath()));
+
+	mapping.Close();
+	EXPECT_TRUE(mapping.GetData().empty());
+
+	// Opening a file closes the previous mapping.
+	ASSERT_TRUE(mapping.Open(firstFile.GetPath()));
+	ASSERT_TRUE(mapping.Open(secondFile.GetPath()));
+
+	const std::span<const uint8_t> mappedData = mapping.GetData();
+	EXPECT_EQ(std::vector<uint8_t>(mappedData.begin(), mappedData.end()), secondData);
+
+	// A failed open also closes the previous mapping.
+	EXPECT_FALSE(mapping.Open(std::filesystem::temp_directory_path() / "RegionalSupplyTestMissing.dat"));
+	EXPECT_TRUE(mapping.GetData().empty());
+}
+
+TEST(MemoryMappedFileTests, ReadsRecordsFromAMappedDataFile)
+{
+	DBPFTestFile dbpf;
+	dbpf.AddRecord(0xA82A8BEC, 0x655AEDB3, 1, { 9, 8, 7, 6 });
+
+	const TemporaryFile file(dbpf.Build());
+
+	MemoryMappedFile mapping;
+	ASSERT_TRUE(mapping.Open(file.GetPath()));
+
+	DBPFIndexReader reader;
+	ASSERT_TRUE(reader.Open(mapping.GetData()));
+
+	std::span<const uint8_t> record;
+	ASSERT_TRUE(reader.FindRecord(0xA82A8BEC, 0x655AEDB3, 1, record));
+	EXPECT_EQ(std::vector<uint8_t>(record.begin(), record.end()), std::vector<uint8_t>({ 9, 8, 7, 6 }));
+}
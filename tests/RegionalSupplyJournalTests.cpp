@@ -0,0 +1,454 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DBPFTestFile.h"
+#include "RegionalSupplyJournal.h"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace
+{
+	using EntryType = RegionalSupplyJournal::EntryType;
+	using ReplayEntry = RegionalSupplyJournal::ReplayEntry;
+
+	constexpr uint32_t JournalSignature = 0x4A445352;
+	constexpr uint32_t JournalVersion = 2;
+	constexpr size_t HeaderSize = 16;
+	constexpr size_t RecordSize = 16;
+
+	// Longer than a city name chunk record, so the name is split across several records.
+	const std::string LongCityName = "City - A city with a long file name.sc4";
+
+	void AppendUint32(std::vector<uint8_t>& data, uint32_t value)
+	{
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+		data.insert(data.end(), bytes, bytes + sizeof(value));
+	}
+
+	std::vector<uint8_t> BuildHeader(uint32_t signature, uint32_t version, uint32_t snapshotSequence)
+	{
+		std::vector<uint8_t> data;
+		AppendUint32(data, signature);
+		AppendUint32(data, version);
+		AppendUint32(data, snapshotSequence);
+		AppendUint32(data, 0);
+
+		return data;
+	}
+
+	void AppendDeltaRecord(std::vector<uint8_t>& data, EntryType type, uint32_t resourceID, int64_t amount)
+	{
+		AppendUint32(data, static_cast<uint32_t>(type));
+		AppendUint32(data, resourceID);
+
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&amount);
+		data.insert(data.end(), bytes, bytes + sizeof(amount));
+	}
+
+	std::vector<uint8_t> ReadFile(const std::filesystem::path& path)
+	{
+		std::ifstream input(path, std::ifstream::in | std::ifstream::binary);
+
+		return std::vector<uint8_t>(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+	}
+
+	void AppendToFile(const std::filesystem::path& path, const std::vector<uint8_t>& data)
+	{
+		std::ofstream output(path, std::ofstream::out | std::ofstream::binary | std::ofstream::app);
+		output.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+	}
+
+	std::vector<ReplayEntry> OpenJournal(
+		RegionalSupplyJournal& journal,
+		const std::filesystem::path& path,
+		uint32_t snapshotSequence,
+		bool* pHasLegacyCityNames = nullptr)
+	{
+		std::vector<ReplayEntry> entries;
+		bool hasLegacyCityNames = false;
+
+		EXPECT_TRUE(journal.Open(path, snapshotSequence, entries, hasLegacyCityNames));
+
+		if (pHasLegacyCityNames)
+		{
+			*pHasLegacyCityNames = hasLegacyCityNames;
+		}
+
+		return entries;
+	}
+
+	void ExpectDelta(const ReplayEntry& entry, EntryType type, uint32_t resourceID, int64_t amount)
+	{
+		EXPECT_EQ(entry.type, type);
+		EXPECT_EQ(entry.delta.resourceID, resourceID);
+		EXPECT_EQ(entry.delta.amount, amount);
+	}
+
+	void ExpectCity(const ReplayEntry& entry, EntryType type, const std::string& cityName)
+	{
+		EXPECT_EQ(entry.type, type);
+		EXPECT_EQ(entry.cityName, cityName);
+	}
+
+	// Checks that the journal was restarted for the snapshot sequence number.
+	void ExpectEmptyJournal(const std::filesystem::path& path, uint32_t snapshotSequence)
+	{
+		EXPECT_EQ(ReadFile(path), BuildHeader(JournalSignature, JournalVersion, snapshotSequence));
+	}
+}
+
+TEST(RegionalSupplyJournalTests, ReplaysAppendedEntriesAfterReopening)
+{
+	TemporaryFile temporaryFile({});
+	const std::filesystem::path& path = temporaryFile.GetPath();
+
+	{
+		RegionalSupplyJournal journal;
+		EXPECT_TRUE(OpenJournal(journal, path, 5).empty());
+
+		const ResourceDelta buildingDeltas[] = { { 1, 10 }, { 2, -3 } };
+		const ResourceDelta regionDelta = { 3, INT64_MIN };
+
+		journal.AppendCityBegin("City - Test.sc4");
+		journal.AppendDeltas(EntryType::BuildingDelta, buildingDeltas, std::size(buildingDeltas));
+		journal.AppendDeltas(EntryType::RegionDelta, &regionDelta, 1);
+		journal.AppendCityRename(LongCityName);
+		journal.AppendCityBegin("");
+
+		// The name chunk records are counted as entries.
+		EXPECT_EQ(journal.GetEntryCount(), 12U);
+		journal.Close();
+	}
+
+	RegionalSupplyJournal journal;
+	bool hasLegacyCityNames = true;
+	const std::vector<ReplayEntry> entries = OpenJournal(journal, path, 5, &hasLegacyCityNames);
+
+	EXPECT_FALSE(hasLegacyCityNames);
+	ASSERT_EQ(entries.size(), 6U);
+	ExpectCity(entries[0], EntryType::CityBegin, "City - Test.sc4");
+	ExpectDelta(entries[1], EntryType::BuildingDelta, 1, 10);
+	ExpectDelta(entries[2], EntryType::BuildingDelta, 2, -3);
+	ExpectDelta(entries[3], EntryType::RegionDelta, 3, INT64_MIN);
+	ExpectCity(entries[4], EntryType::CityRename, LongCityName);
+	ExpectCity(entries[5], EntryType::CityBegin, "");
+	EXPECT_EQ(journal.GetEntryCount(), 12U);
+}
+
+TEST(RegionalSupplyJournalTests, AppendsAfterTheReplayedEntries)
+{
+	TemporaryFile temporaryFile({});
+	const std::filesystem::path& path = temporaryFile.GetPath();
+
+	const ResourceDelta first = { 1, 1 };
+	const ResourceDelta second = { 2, 2 };
+
+	{
+		RegionalSupplyJournal journal;
+		OpenJournal(journal, path, 1);
+		journal.AppendDeltas(EntryType::RegionDelta, &first, 1);
+	}
+
+	{
+		RegionalSupplyJournal journal;
+		ASSERT_EQ(OpenJournal(journal, path, 1).size(), 1U);
+		journal.AppendDeltas(EntryType::RegionDelta, &second, 1);
+	}
+
+	RegionalSupplyJournal journal;
+	const std::vector<ReplayEntry> entries = OpenJournal(journal, path, 1);
+
+	ASSERT_EQ(entries.size(), 2U);
+	ExpectDelta(entries[0], EntryType::RegionDelta, 1, 1);
+	ExpectDelta(entries[1], EntryType::RegionDelta, 2, 2);
+}
+
+TEST(RegionalSupplyJournalTests, OpenForAppendContinuesAtClosedRecordCount)
+{
+	TemporaryFile temporaryFile({});
+	const std::filesystem::path& path = temporaryFile.GetPath();
+
+	const ResourceDelta first = { 1, 1 };
+	const ResourceDelta second = { 2, 2 };
+	size_t recordCount = 0;
+
+	RegionalSupplyJournal journal;
+	OpenJournal(journal, path, 4);
+	journal.AppendCityBegin(LongCityName);
+	journal.AppendDeltas(EntryType::BuildingDelta, &first, 1);
+	recordCount = journal.Close();
+
+	// The city name uses 4 chunk records.
+	EXPECT_EQ(recordCount, 6U);
+
+	ASSERT_TRUE(journal.OpenForAppend(path, 4, recordCount));
+	EXPECT_EQ(journal.GetEntryCount(), recordCount);
+	journal.AppendDeltas(EntryType::RegionDelta, &second, 1);
+	EXPECT_EQ(journal.Close(), recordCount + 1);
+
+	const std::vector<ReplayEntry> entries = OpenJournal(journal, path, 4);
+
+	ASSERT_EQ(entries.size(), 3U);
+	ExpectCity(entries[0], EntryType::CityBegin, LongCityName);
+	ExpectDelta(entries[1], EntryType::BuildingDelta, 1, 1);
+	ExpectDelta(entries[2], EntryType::RegionDelta, 2, 2);
+}
+
+TEST(RegionalSupplyJournalTests, OpenForAppendRejectsMismatchedJournal)
+{
+	std::vector<uint8_t> data = BuildHeader(JournalSignature, JournalVersion, 6);
+	AppendDeltaRecord(data, EntryType::RegionDelta, 1, 100);
+	AppendDeltaRecord(data, EntryType::RegionDelta, 2, -50);
+
+	TemporaryFile temporaryFile(data);
+	const std::filesystem::path& path = temporaryFile.GetPath();
+
+	RegionalSupplyJournal journal;
+
+	EXPECT_FALSE(journal.OpenForAppend(path, 6, 1));
+	EXPECT_FALSE(journal.OpenForAppend(path, 6, 3));
+	EXPECT_FALSE(journal.OpenForAppend(path, 7, 2));
+	EXPECT_FALSE(journal.OpenForAppend(path.string() + ".missing", 6, 0));
+
+	// A rejected journal is left unchanged for Open to validate.
+	EXPECT_EQ(ReadFile(path), data);
+
+	ASSERT_TRUE(journal.OpenForAppend(path, 6, 2));
+	EXPECT_EQ(journal.GetEntryCount(), 2U);
+}
+
+TEST(RegionalSupplyJournalTests, TruncatesPartialTrailingRecord)
+{
+	std::vector<uint8_t> data = BuildHeader(JournalSignature, JournalVersion, 3);
+	AppendDeltaRecord(data, EntryType::RegionDelta, 1, 100);
+	AppendDeltaRecord(data, EntryType::RegionDelta, 2, -50);
+
+	// The start of a record that was interrupted while it was written.
+	std::vector<uint8_t> partialRecord;
+	AppendDeltaRecord(partialRecord, EntryType::RegionDelta, 3, 25);
+	partialRecord.resize(7);
+
+	TemporaryFile temporaryFile(data);
+	const std::filesystem::path& path = temporaryFile.GetPath();
+	AppendToFile(path, partialRecord);
+
+	{
+		RegionalSupplyJournal journal;
+		const std::vector<ReplayEntry> entries = OpenJournal(journal, path, 3);
+
+		ASSERT_EQ(entries.size(), 2U);
+		ExpectDelta(entries[0], EntryType::RegionDelta, 1, 100);
+		ExpectDelta(entries[1], EntryType::RegionDelta, 2, -50);
+		EXPECT_EQ(std::filesystem::file_size(path), HeaderSize + (2 * RecordSize));
+
+		// The new record replaces the partial record.
+		const ResourceDelta delta = { 4, 5 };
+		journal.AppendDeltas(EntryType::RegionDelta, &delta, 1);
+	}
+
+	RegionalSupplyJournal journal;
+	const std::vector<ReplayEntry> entries = OpenJournal(journal, path, 3);
+
+	ASSERT_EQ(entries.size(), 3U);
+	ExpectDelta(entries[2], EntryType::RegionDelta, 4, 5);
+}
+
+TEST(RegionalSupplyJournalTests, RebaseKeepsEntriesAppendedAfterSnapshot)
+{
+	TemporaryFile temporaryFile({});
+	const std::filesystem::path& path = temporaryFile.GetPath();
+
+	{
+		RegionalSupplyJournal journal;
+		OpenJournal(journal, path, 1);
+
+		const ResourceDelta snapshotDelta = { 1, 10 };
+		const ResourceDelta laterDeltas[] = { { 3, 30 }, { 4, -40 } };
+
+		journal.AppendDeltas(EntryType::BuildingDelta, &snapshotDelta, 1);
+
+		// The snapshot includes the entries above.
+		const size_t snapshotEntryCount = journal.GetEntryCount();
+
+		journal.AppendDeltas(EntryType::BuildingDelta, laterDeltas, std::size(laterDeltas));
+		journal.Rebase(2, snapshotEntryCount, nullptr);
+
+		EXPECT_EQ(journal.GetEntryCount(), 2U);
+	}
+
+	{
+		RegionalSupplyJournal journal;
+		const std::vector<ReplayEntry> entries = OpenJournal(journal, path, 2);
+
+		// Without an active city only the kept entries are written.
+		ASSERT_EQ(entries.size(), 2U);
+		ExpectDelta(entries[0], EntryType::BuildingDelta, 3, 30);
+		ExpectDelta(entries[1], EntryType::BuildingDelta, 4, -40);
+	}
+
+	// The journal no longer applies to the previous snapshot.
+	RegionalSupplyJournal journal;
+	EXPECT_TRUE(OpenJournal(journal, path, 1).empty());
+	ExpectEmptyJournal(path, 1);
+}
+
+TEST(RegionalSupplyJournalTests, RebaseStartsWithTheActiveCity)
+{
+	TemporaryFile temporaryFile({});
+	const std::filesystem::path& path = temporaryFile.GetPath();
+
+	{
+		RegionalSupplyJournal journal;
+		OpenJournal(journal, path, 1);
+
+		const ResourceDelta snapshotDeltas[] = { { 1, 10 }, { 2, 20 } };
+		const ResourceDelta laterDeltas[] = { { 3, 30 }, { 4, -40 } };
+
+		journal.AppendCityBegin(LongCityName);
+		journal.AppendDeltas(EntryType::BuildingDelta, snapshotDeltas, std::size(snapshotDeltas));
+
+		// The snapshot includes the entries above.
+		const size_t snapshotEntryCount = journal.GetEntryCount();
+
+		journal.AppendDeltas(EntryType::BuildingDelta, laterDeltas, std::size(laterDeltas));
+		journal.Rebase(2, snapshotEntryCount, &LongCityName);
+
+		const ResourceDelta regionDelta = { 5, 50 };
+		journal.AppendDeltas(EntryType::RegionDelta, &regionDelta, 1);
+	}
+
+	RegionalSupplyJournal journal;
+	const std::vector<ReplayEntry> entries = OpenJournal(journal, path, 2);
+
+	ASSERT_EQ(entries.size(), 4U);
+	ExpectCity(entries[0], EntryType::CityBegin, LongCityName);
+	ExpectDelta(entries[1], EntryType::BuildingDelta, 3, 30);
+	ExpectDelta(entries[2], EntryType::BuildingDelta, 4, -40);
+	ExpectDelta(entries[3], EntryType::RegionDelta, 5, 50);
+}
+
+TEST(RegionalSupplyJournalTests, RestartsJournalForDifferentSnapshot)
+{
+	std::vector<uint8_t> data = BuildHeader(JournalSignature, JournalVersion, 7);
+	AppendDeltaRecord(data, EntryType::RegionDelta, 1, 100);
+
+	TemporaryFile temporaryFile(data);
+
+	RegionalSupplyJournal journal;
+	EXPECT_TRUE(OpenJournal(journal, temporaryFile.GetPath(), 8).empty());
+	ExpectEmptyJournal(temporaryFile.GetPath(), 8);
+	EXPECT_EQ(journal.GetEntryCount(), 0U);
+}
+
+TEST(RegionalSupplyJournalTests, RestartsJournalWithBadSignature)
+{
+	std::vector<uint8_t> data = BuildHeader(0x12345678, JournalVersion, 7);
+	AppendDeltaRecord(data, EntryType::RegionDelta, 1, 100);
+
+	TemporaryFile temporaryFile(data);
+
+	RegionalSupplyJournal journal;
+	EXPECT_TRUE(OpenJournal(journal, temporaryFile.GetPath(), 7).empty());
+	ExpectEmptyJournal(temporaryFile.GetPath(), 7);
+}
+
+TEST(RegionalSupplyJournalTests, RestartsJournalWithUnsupportedVersion)
+{
+	for (const uint32_t version : { 0U, JournalVersion + 1 })
+	{
+		std::vector<uint8_t> data = BuildHeader(JournalSignature, version, 7);
+		AppendDeltaRecord(data, EntryType::RegionDelta, 1, 100);
+
+		TemporaryFile temporaryFile(data);
+
+		RegionalSupplyJournal journal;
+		EXPECT_TRUE(OpenJournal(journal, temporaryFile.GetPath(), 7).empty()) << "version " << version;
+		ExpectEmptyJournal(temporaryFile.GetPath(), 7);
+	}
+}
+
+TEST(RegionalSupplyJournalTests, RestartsJournalWithTruncatedHeader)
+{
+	std::vector<uint8_t> data = BuildHeader(JournalSignature, JournalVersion, 7);
+	data.resize(HeaderSize - 4);
+
+	TemporaryFile temporaryFile(data);
+
+	RegionalSupplyJournal journal;
+	EXPECT_TRUE(OpenJournal(journal, temporaryFile.GetPath(), 7).empty());
+	ExpectEmptyJournal(temporaryFile.GetPath(), 7);
+}
+
+TEST(RegionalSupplyJournalTests, ReadsVersion1JournalWithLegacyCityNames)
+{
+	std::vector<uint8_t> data = BuildHeader(JournalSignature, 1, 7);
+
+	// Version 1 stores the city display name.
+	AppendUint32(data, static_cast<uint32_t>(EntryType::CityBegin));
+	AppendUint32(data, 3);
+	AppendUint32(data, 0);
+	AppendUint32(data, 0);
+	AppendUint32(data, 4);
+	data.insert(data.end(), { 'F', 'o', 'o', 0, 0, 0, 0, 0, 0, 0, 0, 0 });
+	AppendDeltaRecord(data, EntryType::BuildingDelta, 1, 2);
+
+	TemporaryFile temporaryFile(data);
+
+	RegionalSupplyJournal journal;
+	bool hasLegacyCityNames = false;
+	const std::vector<ReplayEntry> entries = OpenJournal(journal, temporaryFile.GetPath(), 7, &hasLegacyCityNames);
+
+	EXPECT_TRUE(hasLegacyCityNames);
+	ASSERT_EQ(entries.size(), 2U);
+	ExpectCity(entries[0], EntryType::CityBegin, "Foo");
+	ExpectDelta(entries[1], EntryType::BuildingDelta, 1, 2);
+}
+
+TEST(RegionalSupplyJournalTests, RewriteUpgradesToCurrentVersion)
+{
+	std::vector<uint8_t> data = BuildHeader(JournalSignature, 1, 7);
+	AppendDeltaRecord(data, EntryType::BuildingDelta, 1, 2);
+
+	TemporaryFile temporaryFile(data);
+	const std::filesystem::path& path = temporaryFile.GetPath();
+
+	{
+		RegionalSupplyJournal journal;
+		std::vector<ReplayEntry> entries = OpenJournal(journal, path, 7);
+		entries.insert(entries.begin(), ReplayEntry{ EntryType::CityBegin, ResourceDelta{}, LongCityName });
+
+		journal.Rewrite(7, entries);
+	}
+
+	RegionalSupplyJournal journal;
+	bool hasLegacyCityNames = true;
+	const std::vector<ReplayEntry> entries = OpenJournal(journal, path, 7, &hasLegacyCityNames);
+
+	EXPECT_FALSE(hasLegacyCityNames);
+	ASSERT_EQ(entries.size(), 2U);
+	ExpectCity(entries[0], EntryType::CityBegin, LongCityName);
+	ExpectDelta(entries[1], EntryType::BuildingDelta, 1, 2);
+}
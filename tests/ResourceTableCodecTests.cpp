@@ -0,0 +1,255 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Crc32C.h"
+#include "ResourceTableCodec.h"
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <vector>
+
+namespace
+{
+	void AppendVarint(std::vector<uint8_t>& data, uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			data.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+
+		data.push_back(static_cast<uint8_t>(value));
+	}
+
+	void AppendChecksum(std::vector<uint8_t>& data)
+	{
+		const uint32_t checksum = Crc32C::Compute(data.data(), data.size());
+
+		for (size_t i = 0; i < 4; i++)
+		{
+			data.push_back(static_cast<uint8_t>(checksum >> (i * 8)));
+		}
+	}
+
+	std::vector<uint8_t> Encode(const ResourceTable& table)
+	{
+		std::vector<uint8_t> data;
+		ResourceTableCodec::Encode(table, data);
+
+		return data;
+	}
+
+	void ExpectTablesEqual(const ResourceTable& actual, const ResourceTable& expected)
+	{
+		EXPECT_EQ(actual.GetCount(), expected.GetCount());
+
+		expected.ForEach([&](uint32_t id, int64_t quantity)
+		{
+			EXPECT_EQ(actual.Get(id), quantity) << "resource id " << id;
+			return true;
+		});
+	}
+
+	void ExpectRoundTrip(const ResourceTable& table)
+	{
+		const std::vector<uint8_t> data = Encode(table);
+
+		ResourceTable decoded;
+		ASSERT_TRUE(ResourceTableCodec::Decode(data.data(), data.size(), decoded));
+
+		ExpectTablesEqual(decoded, table);
+	}
+}
+
+TEST(ResourceTableCodecTests, EncodesEmptyTable)
+{
+	const ResourceTable table;
+	const std::vector<uint8_t> data = Encode(table);
+
+	// The item count followed by the checksum.
+	ASSERT_EQ(data.size(), 5U);
+	EXPECT_EQ(data[0], 0);
+
+	ResourceTable decoded;
+	ASSERT_TRUE(ResourceTableCodec::Decode(data.data(), data.size(), decoded));
+	EXPECT_TRUE(decoded.IsEmpty());
+}
+
+TEST(ResourceTableCodecTests, EncodesSortedIDDeltas)
+{
+	ResourceTable table;
+	table.Set(300, -1);
+	table.Set(5, 64);
+
+	std::vector<uint8_t> expected = { 2, 5, 128, 1, 167, 2, 1 };
+	AppendChecksum(expected);
+
+	EXPECT_EQ(Encode(table), expected);
+}
+
+TEST(ResourceTableCodecTests, RoundTripsQuantityLimits)
+{
+	ResourceTable table;
+	table.Set(0, INT64_MIN);
+	table.Set(1, INT64_MAX);
+	table.Set(2, 0);
+	table.Set(3, -1);
+	table.Set(4, 1);
+	table.Set(0x80000000, INT64_MIN + 1);
+	table.Set(UINT32_MAX, INT64_MAX - 1);
+
+	ExpectRoundTrip(table);
+
+	// A zigzag encoded INT64_MIN or INT64_MAX uses all 10 varint bytes.
+	ResourceTable single;
+	single.Set(UINT32_MAX, INT64_MIN);
+
+	const std::vector<uint8_t> data = Encode(single);
+	EXPECT_EQ(data.size(), 1U + 5U + 10U + 4U);
+
+	ExpectRoundTrip(single);
+}
+
+TEST(ResourceTableCodecTests, RoundTripsPromotedTable)
+{
+	ResourceTable table;
+
+	for (uint32_t i = 0; i < 1000; i++)
+	{
+		table.Set(0x52530000 + (i * 977), (static_cast<int64_t>(i) - 500) * 123456789);
+	}
+
+	ExpectRoundTrip(table);
+}
+
+TEST(ResourceTableCodecTests, RejectsTruncatedData)
+{
+	ResourceTable table;
+
+	for (uint32_t i = 1; i <= 20; i++)
+	{
+		table.Set(i * 1000, static_cast<int64_t>(i) * -100000);
+	}
+
+	const std::vector<uint8_t> data = Encode(table);
+
+	for (size_t size = 0; size < data.size(); size++)
+	{
+		ResourceTable decoded;
+		EXPECT_FALSE(ResourceTableCodec::Decode(data.data(), size, decoded)) << "size " << size;
+	}
+}
+
+TEST(ResourceTableCodecTests, RejectsCorruptData)
+{
+	ResourceTable table;
+	table.Set(10, 1);
+	table.Set(20, -2);
+	table.Set(30, 3);
+
+	const std::vector<uint8_t> data = Encode(table);
+
+	for (size_t i = 0; i < data.size(); i++)
+	{
+		for (uint8_t bit = 1; bit != 0; bit <<= 1)
+		{
+			std::vector<uint8_t> corrupt = data;
+			corrupt[i] ^= bit;
+
+			ResourceTable decoded;
+			EXPECT_FALSE(ResourceTableCodec::Decode(corrupt.data(), corrupt.size(), decoded))
+				<< "byte " << i << ", bit " << static_cast<int>(bit);
+		}
+	}
+}
+
+// The following inputs have a valid checksum but a malformed payload.
+
+TEST(ResourceTableCodecTests, RejectsItemCountLargerThanData)
+{
+	std::vector<uint8_t> data;
+	AppendVarint(data, 100);
+	AppendVarint(data, 1);
+	AppendVarint(data, 2);
+	AppendChecksum(data);
+
+	ResourceTable decoded;
+	EXPECT_FALSE(ResourceTableCodec::Decode(data.data(), data.size(), decoded));
+}
+
+TEST(ResourceTableCodecTests, RejectsDuplicateID)
+{
+	std::vector<uint8_t> data;
+	AppendVarint(data, 2);
+	AppendVarint(data, 7);
+	AppendVarint(data, 2);
+	AppendVarint(data, 0);
+	AppendVarint(data, 4);
+	AppendChecksum(data);
+
+	ResourceTable decoded;
+	EXPECT_FALSE(ResourceTableCodec::Decode(data.data(), data.size(), decoded));
+}
+
+TEST(ResourceTableCodecTests, RejectsIDAbove32Bits)
+{
+	std::vector<uint8_t> data;
+	AppendVarint(data, 2);
+	AppendVarint(data, UINT32_MAX);
+	AppendVarint(data, 2);
+	AppendVarint(data, 1);
+	AppendVarint(data, 2);
+	AppendChecksum(data);
+
+	ResourceTable decoded;
+	EXPECT_FALSE(ResourceTableCodec::Decode(data.data(), data.size(), decoded));
+}
+
+TEST(ResourceTableCodecTests, RejectsOverlongVarint)
+{
+	std::vector<uint8_t> data;
+	AppendVarint(data, 1);
+	AppendVarint(data, 1);
+
+	// 11 bytes is longer than any 64-bit varint.
+	for (size_t i = 0; i < 10; i++)
+	{
+		data.push_back(0x80);
+	}
+
+	data.push_back(0);
+	AppendChecksum(data);
+
+	ResourceTable decoded;
+	EXPECT_FALSE(ResourceTableCodec::Decode(data.data(), data.size(), decoded));
+}
+
+TEST(ResourceTableCodecTests, RejectsTrailingBytes)
+{
+	std::vector<uint8_t> data;
+	AppendVarint(data, 1);
+	AppendVarint(data, 1);
+	AppendVarint(data, 2);
+	data.push_back(0);
+	AppendChecksum(data);
+
+	ResourceTable decoded;
+	EXPECT_FALSE(ResourceTableCodec::Decode(data.data(), data.size(), decoded));
+}
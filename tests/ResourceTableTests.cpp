@@ -0,0 +1,284 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ResourceTable.h"
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace
+{
+	// A HashSlot is 16 bytes and the first hash table has 4 slots per small table entry.
+	constexpr size_t PromotedTableMinimumSize = ResourceTable::SmallTableMaxCount * 4 * 16;
+
+	uint32_t GetTestResourceID(size_t index)
+	{
+		return 0x52530000U + static_cast<uint32_t>(index * 7);
+	}
+
+	void FillTable(ResourceTable& table, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			table.Set(GetTestResourceID(i), static_cast<int64_t>(i) + 1);
+		}
+	}
+
+	void ExpectTableMatches(const ResourceTable& table, const std::map<uint32_t, int64_t>& expected)
+	{
+		EXPECT_EQ(table.GetCount(), expected.size());
+
+		for (const auto& [id, quantity] : expected)
+		{
+			EXPECT_EQ(table.Get(id), quantity) << "resource id " << id;
+		}
+
+		std::map<uint32_t, int64_t> visited;
+
+		table.ForEach([&](uint32_t id, int64_t quantity)
+		{
+			EXPECT_TRUE(visited.emplace(id, quantity).second) << "resource id " << id << " was visited twice";
+			return true;
+		});
+
+		EXPECT_EQ(visited, expected);
+	}
+}
+
+TEST(ResourceTableTests, EmptyTableReturnsZero)
+{
+	ResourceTable table;
+
+	EXPECT_TRUE(table.IsEmpty());
+	EXPECT_EQ(table.GetCount(), 0U);
+	EXPECT_EQ(table.Get(GetTestResourceID(0)), 0);
+	EXPECT_TRUE(table.ForEach([](uint32_t, int64_t) { return false; }));
+}
+
+TEST(ResourceTableTests, SmallTableEnumeratesInIDOrder)
+{
+	ResourceTable table;
+
+	table.Set(30, 3);
+	table.Set(10, 1);
+	table.Set(20, 2);
+
+	std::vector<uint32_t> ids;
+
+	table.ForEach([&](uint32_t id, int64_t)
+	{
+		ids.push_back(id);
+		return true;
+	});
+
+	EXPECT_EQ(ids, (std::vector<uint32_t>{ 10, 20, 30 }));
+}
+
+TEST(ResourceTableTests, FindsEveryIDBeforePromotion)
+{
+	// Covers the 4-wide search and the scalar search of the remainder at every table size.
+	for (size_t count = 1; count <= ResourceTable::SmallTableMaxCount; count++)
+	{
+		ResourceTable table;
+		FillTable(table, count);
+
+		ASSERT_EQ(table.GetCount(), count);
+
+		for (size_t i = 0; i < count; i++)
+		{
+			EXPECT_EQ(table.Get(GetTestResourceID(i)), static_cast<int64_t>(i) + 1) << "count " << count;
+		}
+
+		EXPECT_EQ(table.Get(GetTestResourceID(count)), 0);
+	}
+}
+
+TEST(ResourceTableTests, PromotesAfterThreshold)
+{
+	ResourceTable table;
+	FillTable(table, ResourceTable::SmallTableMaxCount);
+
+	EXPECT_LT(table.GetMemoryUsage(), PromotedTableMinimumSize);
+
+	// Updating an existing id does not promote a full small table.
+	table.Add(GetTestResourceID(0), 10);
+	EXPECT_LT(table.GetMemoryUsage(), PromotedTableMinimumSize);
+
+	table.Set(GetTestResourceID(ResourceTable::SmallTableMaxCount), 100);
+
+	EXPECT_GE(table.GetMemoryUsage(), PromotedTableMinimumSize);
+	EXPECT_EQ(table.GetCount(), ResourceTable::SmallTableMaxCount + 1);
+
+	std::map<uint32_t, int64_t> expected;
+
+	for (size_t i = 0; i < ResourceTable::SmallTableMaxCount; i++)
+	{
+		expected[GetTestResourceID(i)] = static_cast<int64_t>(i) + 1;
+	}
+
+	expected[GetTestResourceID(0)] += 10;
+	expected[GetTestResourceID(ResourceTable::SmallTableMaxCount)] = 100;
+
+	ExpectTableMatches(table, expected);
+}
+
+TEST(ResourceTableTests, LookupsAndUpdatesAfterPromotion)
+{
+	ResourceTable table;
+	std::map<uint32_t, int64_t> expected;
+	std::mt19937 random(12345);
+	std::uniform_int_distribution<int64_t> amounts(-1000, 1000);
+
+	// Enough ids to grow the hash table several times. Id 0 and 0xFFFFFFFF
+	// are valid keys, the slot occupancy is stored separately from the id.
+	std::vector<uint32_t> ids = { 0, 0xFFFFFFFF };
+
+	for (size_t i = 0; i < 2000; i++)
+	{
+		ids.push_back(random());
+	}
+
+	for (size_t round = 0; round < 3; round++)
+	{
+		for (uint32_t id : ids)
+		{
+			const int64_t amount = amounts(random);
+
+			expected[id] += amount;
+			EXPECT_EQ(table.Add(id, amount), expected[id]);
+		}
+	}
+
+	ExpectTableMatches(table, expected);
+
+	for (size_t i = 0; i < 100; i++)
+	{
+		const uint32_t id = random();
+
+		if (!expected.contains(id))
+		{
+			EXPECT_EQ(table.Get(id), 0);
+		}
+	}
+
+	EXPECT_EQ(table.GetCount(), expected.size());
+}
+
+TEST(ResourceTableTests, SequentialIDsAfterPromotion)
+{
+	// Mods may use sequential ids, which must not break the probe sequence.
+	ResourceTable table;
+	std::map<uint32_t, int64_t> expected;
+
+	for (uint32_t id = 0x1000; id < 0x1400; id++)
+	{
+		table.Set(id, id);
+		expected[id] = id;
+	}
+
+	ExpectTableMatches(table, expected);
+}
+
+TEST(ResourceTableTests, ZeroQuantityKeepsResourceAfterPromotion)
+{
+	ResourceTable table;
+	FillTable(table, 100);
+
+	const uint32_t id = GetTestResourceID(50);
+
+	EXPECT_EQ(table.Add(id, -51), 0);
+	EXPECT_EQ(table.GetCount(), 100U);
+
+	bool visited = false;
+
+	table.ForEach([&](uint32_t visitedID, int64_t quantity)
+	{
+		if (visitedID == id)
+		{
+			visited = true;
+			EXPECT_EQ(quantity, 0);
+		}
+		return true;
+	});
+
+	EXPECT_TRUE(visited);
+
+	EXPECT_EQ(table.Add(id, 5), 5);
+	EXPECT_EQ(table.GetCount(), 100U);
+}
+
+TEST(ResourceTableTests, ClearAndReinsertAfterPromotion)
+{
+	ResourceTable table;
+	FillTable(table, 100);
+
+	table.Clear();
+
+	EXPECT_TRUE(table.IsEmpty());
+	EXPECT_EQ(table.Get(GetTestResourceID(0)), 0);
+	EXPECT_EQ(table.Get(GetTestResourceID(99)), 0);
+
+	// Re-inserting starts over with the small table and promotes again.
+	std::map<uint32_t, int64_t> expected;
+
+	for (size_t i = 0; i < 5; i++)
+	{
+		table.Set(GetTestResourceID(i), -static_cast<int64_t>(i));
+		expected[GetTestResourceID(i)] = -static_cast<int64_t>(i);
+	}
+
+	std::vector<uint32_t> ids;
+
+	table.ForEach([&](uint32_t id, int64_t)
+	{
+		ids.push_back(id);
+		return true;
+	});
+
+	EXPECT_TRUE(std::is_sorted(ids.begin(), ids.end()));
+	ExpectTableMatches(table, expected);
+
+	for (size_t i = 5; i < 80; i++)
+	{
+		table.Add(GetTestResourceID(i), 2);
+		expected[GetTestResourceID(i)] = 2;
+	}
+
+	ExpectTableMatches(table, expected);
+}
+
+TEST(ResourceTableTests, ForEachStopsWhenFunctionReturnsFalse)
+{
+	ResourceTable table;
+	FillTable(table, 100);
+
+	size_t visitCount = 0;
+
+	EXPECT_FALSE(table.ForEach([&](uint32_t, int64_t)
+	{
+		visitCount++;
+		return visitCount < 10;
+	}));
+
+	EXPECT_EQ(visitCount, 10U);
+}
@@ -0,0 +1,318 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ShardedResourceTable.h"
+#include <array>
+#include <atomic>
+#include <gtest/gtest.h>
+#include <map>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	constexpr size_t WriterThreadCount = 4;
+	constexpr size_t ReaderThreadCount = 4;
+	// Enough ids per writer to grow every shard several times.
+	constexpr size_t IDsPerWriter = 2000;
+	constexpr int64_t AddsPerID = 3;
+
+	uint32_t GetWriterResourceID(size_t writer, size_t index)
+	{
+		return static_cast<uint32_t>((writer << 24) | (index * 13 + 1));
+	}
+}
+
+TEST(ShardedResourceTableTests, SetGetAndCount)
+{
+	ShardedResourceTable table;
+
+	EXPECT_TRUE(table.IsEmpty());
+	EXPECT_EQ(table.Get(1), 0);
+
+	table.Set(1, 10);
+	EXPECT_EQ(table.Add(1, -4), 6);
+	EXPECT_EQ(table.Add(2, 5), 5);
+
+	EXPECT_EQ(table.Get(1), 6);
+	EXPECT_EQ(table.Get(2), 5);
+	EXPECT_EQ(table.GetCount(), 2U);
+
+	table.Clear();
+
+	EXPECT_TRUE(table.IsEmpty());
+	EXPECT_EQ(table.Get(1), 0);
+}
+
+TEST(ShardedResourceTableTests, StoreMaxKeepsLargerValue)
+{
+	ShardedResourceTable table;
+
+	EXPECT_EQ(table.StoreMax(1, 5), 5);
+	EXPECT_EQ(table.StoreMax(1, 3), 5);
+	EXPECT_EQ(table.Get(1), 5);
+	EXPECT_EQ(table.StoreMax(1, 8), 8);
+	EXPECT_EQ(table.Get(1), 8);
+
+	// A missing resource starts at zero.
+	EXPECT_EQ(table.StoreMax(2, -1), 0);
+	EXPECT_EQ(table.GetCount(), 2U);
+}
+
+TEST(ShardedResourceTableTests, ConcurrentStoreMaxNeverDecreases)
+{
+	constexpr size_t ThreadCount = 4;
+	constexpr int64_t ValuesPerThread = 20000;
+	constexpr uint32_t ResourceCount = 8;
+
+	ShardedResourceTable table;
+	std::atomic<int64_t> nextValue = 0;
+	std::atomic<size_t> decreases = 0;
+	std::vector<std::thread> threads;
+
+	for (size_t thread = 0; thread < ThreadCount; thread++)
+	{
+		threads.emplace_back([&]()
+		{
+			std::array<int64_t, ResourceCount> lastSeen{};
+
+			for (int64_t i = 0; i < ValuesPerThread; i++)
+			{
+				// The values are taken in increasing order but stored in any order,
+				// in the same way as the manager's resource generations.
+				const int64_t value = nextValue.fetch_add(1) + 1;
+				const uint32_t id = static_cast<uint32_t>(value % ResourceCount);
+
+				table.StoreMax(id, value);
+
+				const int64_t stored = table.Get(id);
+
+				if (stored < value || stored < lastSeen[id])
+				{
+					decreases++;
+				}
+
+				lastSeen[id] = stored;
+			}
+		});
+	}
+
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	EXPECT_EQ(decreases.load(), 0U);
+
+	const int64_t lastValue = nextValue.load();
+
+	for (uint32_t id = 0; id < ResourceCount; id++)
+	{
+		// The largest value with this remainder.
+		EXPECT_EQ(table.Get(id), lastValue - ((lastValue - id) % ResourceCount));
+	}
+}
+
+TEST(ShardedResourceTableTests, AssignAndCopyTo)
+{
+	ResourceTable source;
+
+	for (uint32_t id = 1; id <= 500; id++)
+	{
+		source.Set(id, static_cast<int64_t>(id) * 2);
+	}
+
+	ShardedResourceTable table;
+	table.Set(1000, 1);
+	table.Assign(source);
+
+	EXPECT_EQ(table.GetCount(), 500U);
+	EXPECT_EQ(table.Get(1000), 0);
+
+	ResourceTable copy;
+	copy.Set(2000, 1);
+	table.CopyTo(copy);
+
+	EXPECT_EQ(copy.GetCount(), 500U);
+
+	source.ForEach([&](uint32_t id, int64_t quantity)
+	{
+		EXPECT_EQ(copy.Get(id), quantity);
+		return true;
+	});
+}
+
+// The writers grow every shard while the readers probe and copy the table,
+// so the readers keep probing slot arrays that have been retired.
+// Run this test with AddressSanitizer or ThreadSanitizer to check that a
+// retired array is not freed while a reader is using it.
+TEST(ShardedResourceTableTests, ReadersWhileWritersGrowTable)
+{
+	ShardedResourceTable table;
+	std::atomic<bool> writersDone = false;
+	std::atomic<size_t> readerErrors = 0;
+	std::atomic<size_t> readerPasses = 0;
+
+	std::vector<std::thread> readers;
+
+	for (size_t reader = 0; reader < ReaderThreadCount; reader++)
+	{
+		readers.emplace_back([&, reader]()
+		{
+			// The quantities only grow, so each reader must see them increase monotonically.
+			std::map<uint32_t, int64_t> lastSeen;
+			ResourceTable copy;
+
+			do
+			{
+				for (size_t writer = 0; writer < WriterThreadCount; writer++)
+				{
+					for (size_t i = reader; i < IDsPerWriter; i += 97)
+					{
+						const uint32_t id = GetWriterResourceID(writer, i);
+						const int64_t quantity = table.Get(id);
+						int64_t& previous = lastSeen[id];
+
+						if (quantity < previous || quantity > AddsPerID)
+						{
+							readerErrors++;
+						}
+
+						previous = quantity;
+					}
+				}
+
+				table.CopyTo(copy);
+
+				if (copy.GetCount() > WriterThreadCount * IDsPerWriter)
+				{
+					readerErrors++;
+				}
+
+				copy.ForEach([&](uint32_t, int64_t quantity)
+				{
+					if (quantity < 0 || quantity > AddsPerID)
+					{
+						readerErrors++;
+					}
+					return true;
+				});
+
+				readerPasses++;
+			} while (!writersDone.load());
+		});
+	}
+
+	std::vector<std::thread> writers;
+
+	for (size_t writer = 0; writer < WriterThreadCount; writer++)
+	{
+		writers.emplace_back([&, writer]()
+		{
+			for (int64_t pass = 0; pass < AddsPerID; pass++)
+			{
+				for (size_t i = 0; i < IDsPerWriter; i++)
+				{
+					table.Add(GetWriterResourceID(writer, i), 1);
+				}
+			}
+		});
+	}
+
+	for (std::thread& thread : writers)
+	{
+		thread.join();
+	}
+
+	writersDone = true;
+
+	for (std::thread& thread : readers)
+	{
+		thread.join();
+	}
+
+	EXPECT_EQ(readerErrors.load(), 0U);
+	EXPECT_GE(readerPasses.load(), ReaderThreadCount);
+
+	EXPECT_EQ(table.GetCount(), WriterThreadCount * IDsPerWriter);
+
+	ResourceTable copy;
+	table.CopyTo(copy);
+
+	EXPECT_EQ(copy.GetCount(), WriterThreadCount * IDsPerWriter);
+
+	int64_t total = 0;
+
+	copy.ForEach([&](uint32_t, int64_t quantity)
+	{
+		total += quantity;
+		return true;
+	});
+
+	EXPECT_EQ(total, static_cast<int64_t>(WriterThreadCount * IDsPerWriter) * AddsPerID);
+
+	for (size_t writer = 0; writer < WriterThreadCount; writer++)
+	{
+		for (size_t i = 0; i < IDsPerWriter; i++)
+		{
+			ASSERT_EQ(table.Get(GetWriterResourceID(writer, i)), AddsPerID);
+		}
+	}
+}
+
+TEST(ShardedResourceTableTests, ReadersWhileTableIsCleared)
+{
+	ShardedResourceTable table;
+	std::atomic<bool> writerDone = false;
+	std::atomic<size_t> readerErrors = 0;
+
+	std::thread reader([&]()
+	{
+		do
+		{
+			for (uint32_t id = 1; id <= 200; id++)
+			{
+				const int64_t quantity = table.Get(id);
+
+				if (quantity != 0 && quantity != id)
+				{
+					readerErrors++;
+				}
+			}
+		} while (!writerDone.load());
+	});
+
+	for (size_t pass = 0; pass < 200; pass++)
+	{
+		for (uint32_t id = 1; id <= 200; id++)
+		{
+			table.Set(id, id);
+		}
+
+		table.Clear();
+	}
+
+	writerDone = true;
+	reader.join();
+
+	EXPECT_EQ(readerErrors.load(), 0U);
+	EXPECT_TRUE(table.IsEmpty());
+}
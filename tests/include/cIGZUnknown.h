@@ -0,0 +1,36 @@
+/*
+ * This file is part of SC4RegionalSupplyDemand, a DLL Plugin for SimCity 4
+ * that implements a basic regional supply/demand system.
+ *
+ * Copyright (C) 2025 Nicholas Hayes
+ *
+ * SC4RegionalSupplyDemand is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * SC4RegionalSupplyDemand is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SC4RegionalSupplyDemand.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <cstdint>
+
+// The tests use this copy of the gzcom-dll cIGZUnknown interface when the
+// vendor/gzcom-dll submodule is not checked out. The plugin headers that the
+// tests include only need the interface declaration.
+static const uint32_t GZIID_cIGZUnknown = 0x00000001;
+
+class cIGZUnknown
+{
+public:
+	virtual bool QueryInterface(uint32_t riid, void** ppvObj) = 0;
+	virtual uint32_t AddRef() = 0;
+	virtual uint32_t Release() = 0;
+};